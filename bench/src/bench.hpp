@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef DRYC_BENCH
+#define DRYC_BENCH
+
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string_view>
+
+#include "util/num.hpp"
+
+namespace dry::bench {
+
+using bench_fun = void(*)();
+
+struct benchmark_entry {
+    std::string_view name;
+    bench_fun fun;
+};
+
+std::vector<benchmark_entry>& benchmarks();
+
+struct registrar {
+    registrar(std::string_view name, bench_fun fun) {
+        benchmarks().push_back({ name, fun });
+    }
+};
+
+#define DRY_BENCHMARK(fun) static const dry::bench::registrar fun##_registrar{ #fun, fun }
+
+// one result line, time is per element
+// NOTE : printed right away or collected for the json dump, see main
+void report(std::string_view group, std::string_view name, u64_t element_count, f64_t ns);
+
+// keep the optimizer from throwing results away
+template<typename T>
+inline void do_not_optimize(const T& val) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&val) : "memory");
+#else
+    static const void* volatile sink = nullptr;
+    sink = &val;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// runs fun repeats times, returns the fastest run in nanoseconds
+template<typename Fun>
+f64_t measure(u32_t repeats, Fun&& fun) {
+    f64_t best = 0;
+    for (auto i = 0u; i < repeats; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        fun();
+        const auto t1 = std::chrono::steady_clock::now();
+
+        const f64_t ns = std::chrono::duration<f64_t, std::nano>(t1 - t0).count();
+        best = (i == 0 || ns < best) ? ns : best;
+    }
+    return best;
+}
+
+// same, setup() is rerun untimed before every repeat and its result passed to fun
+template<typename Setup, typename Fun>
+f64_t measure(u32_t repeats, Setup&& setup, Fun&& fun) {
+    f64_t best = 0;
+    for (auto i = 0u; i < repeats; ++i) {
+        auto state = setup();
+
+        const auto t0 = std::chrono::steady_clock::now();
+        fun(state);
+        const auto t1 = std::chrono::steady_clock::now();
+
+        const f64_t ns = std::chrono::duration<f64_t, std::nano>(t1 - t0).count();
+        best = (i == 0 || ns < best) ? ns : best;
+        do_not_optimize(state);
+    }
+    return best;
+}
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include <array>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+
+#include "bench.hpp"
+
+#include "util/sparse_table.hpp"
+#include "util/concurrent_sparse_table.hpp"
+#include "util/thread_pool.hpp"
+
+using namespace dry;
+using namespace dry::bench;
+
+namespace {
+
+struct element {
+    f32_t x, y, z, w;
+};
+
+constexpr std::array element_counts{ 10'000ull, 1'000'000ull };
+constexpr u32_t repeats = 10;
+constexpr u64_t min_chunk = 256;
+
+// a sparse_table behind one mutex, what the concurrent table replaces
+struct locked_table {
+    std::mutex mutex;
+    sparse_table<element> table;
+
+    sparse_table<element>::index_t emplace(const element& el) {
+        std::lock_guard lock{ mutex };
+        return table.emplace(el);
+    }
+    void remove(sparse_table<element>::index_t index) {
+        std::lock_guard lock{ mutex };
+        table.remove(index);
+    }
+};
+
+// every thread emplaces its chunk, then churn removes each element and emplaces a new one
+// so the free slot stack is pushed and popped from all threads at once
+template<typename Table>
+void run(const char* group, const char* name, u64_t count, thread_pool& pool) {
+    char label[64];
+
+    const f64_t emplace_ns = measure(repeats, [&] {
+        auto table = std::make_unique<Table>();
+        pool.parallel_for(count, min_chunk, [&](u64_t beg, u64_t end) {
+            for (auto i = beg; i < end; ++i) {
+                table->emplace(element{ static_cast<f32_t>(i), 0, 0, 0 });
+            }
+        });
+        do_not_optimize(table);
+    });
+    snprintf(label, sizeof label, "%s emplace %u threads", name, pool.thread_count());
+    report(group, label, count, emplace_ns);
+
+    const auto make_filled = [&] {
+        auto table = std::make_unique<Table>();
+        std::vector<u64_t> indices(count);
+        for (auto i = 0ull; i < count; ++i) {
+            indices[i] = table->emplace(element{ static_cast<f32_t>(i), 0, 0, 0 });
+        }
+        return std::pair{ std::move(table), std::move(indices) };
+    };
+    const f64_t churn_ns = measure(repeats, make_filled, [&](auto& state) {
+        pool.parallel_for(count, min_chunk, [&](u64_t beg, u64_t end) {
+            for (auto i = beg; i < end; ++i) {
+                state.first->remove(state.second[i]);
+                state.second[i] = state.first->emplace(element{ static_cast<f32_t>(i), 1, 0, 0 });
+            }
+        });
+    });
+    snprintf(label, sizeof label, "%s remove+emplace %u threads", name, pool.thread_count());
+    report(group, label, count, churn_ns);
+}
+
+void concurrent_containers() {
+    // NOTE : at least 4 threads so the case contends even on small machines
+    thread_pool single{ 0 };
+    thread_pool pool{ (std::max)(thread_pool::default_worker_count(), 3u) };
+
+    for (const auto count : element_counts) {
+        char group[32];
+        snprintf(group, sizeof group, "concurrent n=%llu", static_cast<unsigned long long>(count));
+
+        run<concurrent_sparse_table<element>>(group, "concurrent_sparse_table", count, single);
+        run<concurrent_sparse_table<element>>(group, "concurrent_sparse_table", count, pool);
+        run<locked_table>(group, "mutex sparse_table", count, pool);
+    }
+}
+
+}
+
+DRY_BENCHMARK(concurrent_containers);
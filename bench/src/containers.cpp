@@ -0,0 +1,128 @@
+#include <random>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+
+#include "bench.hpp"
+
+#include "util/sparse_array.hpp"
+#include "util/sparse_table.hpp"
+
+using namespace dry;
+using namespace dry::bench;
+
+namespace {
+
+struct element {
+    f32_t x, y, z, w;
+};
+
+constexpr std::array element_counts{ 10'000ull, 1'000'000ull };
+constexpr u32_t repeats = 10;
+
+std::vector<u64_t> shuffled_indices(u64_t count) {
+    std::vector<u64_t> ret(count);
+    std::iota(ret.begin(), ret.end(), 0ull);
+    std::shuffle(ret.begin(), ret.end(), std::mt19937_64{ count });
+    return ret;
+}
+
+template<typename Container>
+Container filled(u64_t count) {
+    Container ret;
+    for (auto i = 0ull; i < count; ++i) {
+        if constexpr (requires { ret.push_back(element{}); }) {
+            ret.push_back(element{ static_cast<f32_t>(i), 0, 0, 0 });
+        } else if constexpr (requires { typename Container::mapped_type; }) {
+            ret.emplace(i, element{ static_cast<f32_t>(i), 0, 0, 0 });
+        } else {
+            ret.emplace(element{ static_cast<f32_t>(i), 0, 0, 0 });
+        }
+    }
+    return ret;
+}
+
+f32_t value_of(const element& el) {
+    return el.x;
+}
+f32_t value_of(const std::pair<const u64_t, element>& el) {
+    return el.second.x;
+}
+
+// emplace, remove in random order, full iteration and random access over count elements
+template<typename Container>
+void run(const char* group, const char* name, u64_t count) {
+    const auto indices = shuffled_indices(count);
+    char label[40];
+
+    const f64_t emplace_ns = measure(repeats, [&] {
+        auto cont = filled<Container>(count);
+        do_not_optimize(cont);
+    });
+    snprintf(label, sizeof label, "%s emplace", name);
+    report(group, label, count, emplace_ns);
+
+    // NOTE : std::vector has no stable removal, only the keyed containers are measured
+    if constexpr (!requires(Container c) { c.push_back(element{}); }) {
+        const f64_t remove_ns = measure(repeats, [&] { return filled<Container>(count); }, [&](Container& cont) {
+            for (const auto ind : indices) {
+                if constexpr (requires { cont.remove(ind); }) {
+                    cont.remove(ind);
+                } else {
+                    cont.erase(ind);
+                }
+            }
+        });
+        snprintf(label, sizeof label, "%s remove", name);
+        report(group, label, count, remove_ns);
+    }
+
+    const auto cont = filled<Container>(count);
+
+    const f64_t iterate_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        if constexpr (requires { cont.begin(); }) {
+            for (const auto& el : cont) {
+                sum += value_of(el);
+            }
+        } else {
+            cont.for_each([&sum](const element& el) { sum += value_of(el); });
+        }
+        do_not_optimize(sum);
+    });
+    snprintf(label, sizeof label, "%s iterate", name);
+    report(group, label, count, iterate_ns);
+
+    const f64_t access_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        for (const auto ind : indices) {
+            if constexpr (requires { cont.find(ind)->second; }) {
+                sum += value_of(*cont.find(ind));
+            } else {
+                sum += value_of(cont[ind]);
+            }
+        }
+        do_not_optimize(sum);
+    });
+    snprintf(label, sizeof label, "%s random_access", name);
+    report(group, label, count, access_ns);
+}
+
+void containers() {
+    for (const auto count : element_counts) {
+        char group[32];
+        snprintf(group, sizeof group, "containers n=%llu", static_cast<unsigned long long>(count));
+
+        run<std::vector<element>>(group, "vector", count);
+        run<std::unordered_map<u64_t, element>>(group, "unordered_map", count);
+        run<sparse_array<element>>(group, "sparse_array", count);
+        run<sparse_table<element>>(group, "sparse_table", count);
+    }
+}
+
+}
+
+DRY_BENCHMARK(containers);
@@ -0,0 +1,446 @@
+#include <random>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <tuple>
+#include <memory>
+#include <cstdio>
+#include <filesystem>
+
+#include "bench.hpp"
+
+#include "ecs/ecs.hpp"
+#include "ecs/archetype.hpp"
+#include "ecs/static_registry.hpp"
+#include "ecs/snapshot.hpp"
+#include "ecs/command_buffer.hpp"
+#include "util/thread_pool.hpp"
+
+using namespace dry;
+using namespace dry::bench;
+
+namespace {
+
+struct position {
+    f32_t x, y, z;
+};
+struct velocity {
+    f32_t x, y, z;
+};
+
+constexpr std::array entity_counts{ 10'000ull, 1'000'000ull };
+constexpr u32_t repeats = 10;
+
+std::vector<ecs::entity> shuffled_entities(u64_t count) {
+    std::vector<ecs::entity> ret(count);
+    std::iota(ret.begin(), ret.end(), ecs::entity{ 0 });
+    std::shuffle(ret.begin(), ret.end(), std::mt19937_64{ count });
+    return ret;
+}
+
+void component_set_ops(const char* group, u64_t count) {
+    const auto entities = shuffled_entities(count);
+
+    const f64_t emplace_ns = measure(repeats, [&] {
+        ecs::component_set<position> set;
+        for (const auto ent : entities) {
+            set.emplace(ent, static_cast<f32_t>(ent), 0.f, 0.f);
+        }
+        do_not_optimize(set);
+    });
+    report(group, "component_set emplace", count, emplace_ns);
+
+    const f64_t map_emplace_ns = measure(repeats, [&] {
+        std::unordered_map<ecs::entity, position> map;
+        for (const auto ent : entities) {
+            map.emplace(ent, position{ static_cast<f32_t>(ent), 0.f, 0.f });
+        }
+        do_not_optimize(map);
+    });
+    report(group, "unordered_map emplace", count, map_emplace_ns);
+
+    const auto make_set = [&] {
+        auto set = std::make_unique<ecs::component_set<position>>();
+        for (auto ent = 0u; ent < count; ++ent) {
+            set->emplace(ent, static_cast<f32_t>(ent), 0.f, 0.f);
+        }
+        return set;
+    };
+    const f64_t remove_ns = measure(repeats, make_set, [&](auto& set) {
+        for (const auto ent : entities) {
+            set->remove(ent);
+        }
+    });
+    report(group, "component_set remove", count, remove_ns);
+
+    const auto make_map = [&] {
+        std::unordered_map<ecs::entity, position> map;
+        for (auto ent = 0u; ent < count; ++ent) {
+            map.emplace(ent, position{ static_cast<f32_t>(ent), 0.f, 0.f });
+        }
+        return map;
+    };
+    const f64_t map_remove_ns = measure(repeats, make_map, [&](auto& map) {
+        for (const auto ent : entities) {
+            map.erase(ent);
+        }
+    });
+    report(group, "unordered_map remove", count, map_remove_ns);
+
+    const auto set = make_set();
+    const f64_t iterate_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        for (const auto& pos : std::as_const(*set)) {
+            sum += pos.x;
+        }
+        do_not_optimize(sum);
+    });
+    report(group, "component_set iterate", count, iterate_ns);
+
+    const f64_t get_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        for (const auto ent : entities) {
+            sum += std::as_const(*set).get(ent).x;
+        }
+        do_not_optimize(sum);
+    });
+    report(group, "component_set get", count, get_ns);
+}
+
+// every entity has a position, every other one a velocity
+void view_ops(const char* group, u64_t count) {
+    ecs::component_set<position> positions;
+    ecs::component_set<velocity> velocities;
+    std::unordered_map<ecs::entity, position> position_map;
+    std::unordered_map<ecs::entity, velocity> velocity_map;
+
+    for (const auto ent : shuffled_entities(count)) {
+        positions.emplace(ent, static_cast<f32_t>(ent), 0.f, 0.f);
+        position_map.emplace(ent, position{ static_cast<f32_t>(ent), 0.f, 0.f });
+        if (ent % 2 == 0) {
+            velocities.emplace(ent, 1.f, 0.f, 0.f);
+            velocity_map.emplace(ent, velocity{ 1.f, 0.f, 0.f });
+        }
+    }
+
+    const f64_t view_ns = measure(repeats, [&] {
+        ecs::component_view<position, velocity> view{ &positions, &velocities };
+        for (const auto ent : view) {
+            auto [pos, vel] = view.get<position, velocity>(ent);
+            pos.x += vel.x;
+        }
+        do_not_optimize(positions);
+    });
+    report(group, "view<pos, vel> iterate", count, view_ns);
+
+    const f64_t map_ns = measure(repeats, [&] {
+        for (const auto& [ent, vel] : velocity_map) {
+            position_map.find(ent)->second.x += vel.x;
+        }
+        do_not_optimize(position_map);
+    });
+    report(group, "unordered_map join", count, map_ns);
+
+    ecs::ec_registry registry;
+    for (auto i = 0ull; i < count; ++i) {
+        const ecs::entity ent = registry.create();
+        registry.attach<position>(ent, static_cast<f32_t>(i), 0.f, 0.f);
+        if (i % 2 == 0) {
+            registry.attach<velocity>(ent, 1.f, 0.f, 0.f);
+        }
+    }
+    auto pos_vel = registry.group<position, velocity>();
+
+    const f64_t group_ns = measure(repeats, [&] {
+        pos_vel.each([](position& pos, const velocity& vel) {
+            pos.x += vel.x;
+        });
+        do_not_optimize(registry);
+    });
+    report(group, "group<pos, vel> each", count, group_ns);
+
+    ecs::archetype_registry archetypes;
+    for (auto i = 0ull; i < count; ++i) {
+        const ecs::entity ent = archetypes.create();
+        archetypes.attach<position>(ent, static_cast<f32_t>(i), 0.f, 0.f);
+        if (i % 2 == 0) {
+            archetypes.attach<velocity>(ent, 1.f, 0.f, 0.f);
+        }
+    }
+
+    const f64_t archetype_ns = measure(repeats, [&] {
+        archetypes.each<position, velocity>([](position& pos, const velocity& vel) {
+            pos.x += vel.x;
+        });
+        do_not_optimize(archetypes);
+    });
+    report(group, "archetype each<pos, vel>", count, archetype_ns);
+}
+
+template<u32_t N>
+struct tag_component {
+    u32_t value;
+};
+
+constexpr u32_t despawn_type_count = 64;
+constexpr u32_t components_per_entity = 3;
+
+// every entity gets components_per_entity of despawn_type_count types
+template<typename Registry, u32_t... N>
+void attach_some(Registry& reg, ecs::entity ent, std::integer_sequence<u32_t, N...>) {
+    const u32_t first = ecs::entity_index(ent) % despawn_type_count;
+    ((((N - first) % despawn_type_count) < components_per_entity ? reg.template attach<tag_component<N>>(ent, N) : void()), ...);
+}
+
+template<u32_t... N>
+auto make_static_registry(std::integer_sequence<u32_t, N...>) {
+    return std::make_unique<ecs::static_registry<tag_component<N>...>>();
+}
+
+// mass despawn, the registry only visits the pools in each entity's mask
+template<typename Make>
+f64_t measure_despawn(u64_t count, Make make) {
+    const auto make_registry = [&] {
+        auto reg = make();
+        std::vector<ecs::entity> entities(count);
+        for (auto& ent : entities) {
+            ent = reg->create();
+            attach_some(*reg, ent, std::make_integer_sequence<u32_t, despawn_type_count>{});
+        }
+        return std::pair{ std::move(reg), std::move(entities) };
+    };
+    return measure(repeats, make_registry, [](auto& state) {
+        for (const auto ent : state.second) {
+            state.first->destroy(ent);
+        }
+    });
+}
+
+void registry_despawn(const char* group, u64_t count) {
+    const f64_t dynamic_ns = measure_despawn(count, [] {
+        return std::make_unique<ecs::ec_registry>();
+    });
+    report(group, "registry destroy 64 types", count, dynamic_ns);
+
+    const f64_t static_ns = measure_despawn(count, [] {
+        return make_static_registry(std::make_integer_sequence<u32_t, despawn_type_count>{});
+    });
+    report(group, "static_registry destroy 64 types", count, static_ns);
+}
+
+// every entity gets a velocity and every 4th is destroyed, recorded from several threads
+// through a command_queue and applied against doing it directly on one thread
+void registry_commands(const char* group, u64_t count) {
+    const auto n = static_cast<u32_t>(count);
+    // NOTE : at least 4 threads so the thread local buffers are exercised even on small machines
+    thread_pool pool{ (std::max)(thread_pool::default_worker_count(), 3u) };
+    char name[64];
+
+    const auto make_registry = [&] {
+        auto reg = std::make_unique<ecs::ec_registry>();
+        std::vector<ecs::entity> entities(n);
+        reg->create_n(entities.data(), n);
+        reg->attach_range(entities.data(), n, position{ 0.f, 0.f, 0.f });
+        return std::pair{ std::move(reg), std::move(entities) };
+    };
+
+    const f64_t direct_ns = measure(repeats, make_registry, [](auto& state) {
+        ecs::ec_registry& reg = *state.first;
+        for (auto i = 0u; i < state.second.size(); ++i) {
+            reg.attach<velocity>(state.second[i], 1.f, 0.f, 0.f);
+            if (i % 4 == 0) {
+                reg.destroy(state.second[i]);
+            }
+        }
+    });
+    report(group, "registry attach+destroy direct", count, direct_ns);
+
+    const f64_t queue_ns = measure(repeats, make_registry, [&](auto& state) {
+        ecs::command_queue queue{ *state.first };
+        pool.parallel_for(count, 1024, [&](u64_t beg, u64_t end) {
+            auto& cmds = queue.local();
+            for (auto i = beg; i < end; ++i) {
+                cmds.attach<velocity>(state.second[i], 1.f, 0.f, 0.f);
+                if (i % 4 == 0) {
+                    cmds.destroy(state.second[i]);
+                }
+            }
+        });
+        queue.apply();
+    });
+    snprintf(name, sizeof name, "command_queue %u threads record+apply", pool.thread_count());
+    report(group, name, count, queue_ns);
+}
+
+// crowd spawn and despawn, one create/attach/destroy per entity against the range calls
+void registry_bulk(const char* group, u64_t count) {
+    const auto n = static_cast<u32_t>(count);
+
+    const f64_t spawn_ns = measure(repeats, [&] {
+        ecs::ec_registry reg;
+        for (auto i = 0u; i < n; ++i) {
+            const ecs::entity ent = reg.create();
+            reg.attach<position>(ent, 0.f, 0.f, 0.f);
+            reg.attach<velocity>(ent, 1.f, 0.f, 0.f);
+        }
+        do_not_optimize(reg);
+    });
+    report(group, "registry spawn per entity", count, spawn_ns);
+
+    const f64_t spawn_range_ns = measure(repeats, [&] {
+        ecs::ec_registry reg;
+        std::vector<ecs::entity> entities(n);
+        reg.create_n(entities.data(), n);
+        reg.attach_range(entities.data(), n, position{ 0.f, 0.f, 0.f });
+        reg.attach_range(entities.data(), n, velocity{ 1.f, 0.f, 0.f });
+        do_not_optimize(reg);
+    });
+    report(group, "registry spawn range", count, spawn_range_ns);
+
+    const auto make_registry = [&] {
+        auto reg = std::make_unique<ecs::ec_registry>();
+        std::vector<ecs::entity> entities(n);
+        reg->create_n(entities.data(), n);
+        reg->attach_range(entities.data(), n, position{ 0.f, 0.f, 0.f });
+        reg->attach_range(entities.data(), n, velocity{ 1.f, 0.f, 0.f });
+        // every other entity in random order
+        std::erase_if(entities, [](ecs::entity ent) { return ecs::entity_index(ent) % 2 != 0; });
+        std::shuffle(entities.begin(), entities.end(), std::mt19937_64{ count });
+        return std::pair{ std::move(reg), std::move(entities) };
+    };
+    const f64_t despawn_ns = measure(repeats, make_registry, [](auto& state) {
+        for (const auto ent : state.second) {
+            state.first->destroy(ent);
+        }
+    });
+    report(group, "registry despawn half per entity", count / 2, despawn_ns);
+
+    const f64_t despawn_range_ns = measure(repeats, make_registry, [](auto& state) {
+        state.first->destroy_range(state.second.data(), static_cast<u32_t>(state.second.size()));
+    });
+    report(group, "registry despawn half range", count / 2, despawn_range_ns);
+}
+
+// scene load, rebuilding through attach against a mapped snapshot of the same registry
+void registry_snapshot(const char* group, u64_t count) {
+    const auto n = static_cast<u32_t>(count);
+    const auto build = [n] {
+        auto reg = std::make_unique<ecs::ec_registry>();
+        for (auto i = 0u; i < n; ++i) {
+            const ecs::entity ent = reg->create();
+            reg->attach<position>(ent, static_cast<f32_t>(i), 0.f, 0.f);
+            if (i % 2 == 0) {
+                reg->attach<velocity>(ent, 1.f, 0.f, 0.f);
+            }
+        }
+        return reg;
+    };
+    const f64_t attach_ns = measure(repeats, [&] {
+        do_not_optimize(build());
+    });
+    report(group, "scene load attach", count, attach_ns);
+
+    ecs::snapshot snap;
+    snap.add<position>("position");
+    snap.add<velocity>("velocity");
+    const auto path = std::filesystem::temp_directory_path() / "dry_bench_scene.snap";
+    snap.save(*build(), path);
+
+    const f64_t load_ns = measure(repeats, [&] {
+        auto reg = std::make_unique<ecs::ec_registry>();
+        snap.load(*reg, path);
+        do_not_optimize(reg);
+    });
+    report(group, "scene load snapshot", count, load_ns);
+    std::filesystem::remove(path);
+}
+
+template<u32_t N>
+struct overlap_component {
+    f32_t value;
+};
+
+// every pool holds half of the entities, the main pool's ones show up in each other pool
+// with probability overlap, one at a time through the iterator against the batched each
+template<u32_t... N>
+void view_overlap(const char* group, u64_t count, u32_t overlap_pct, std::integer_sequence<u32_t, N...>) {
+    std::mt19937_64 rng{ count + overlap_pct };
+    const auto half = static_cast<u32_t>(count / 2);
+    auto pools = std::make_tuple(std::make_unique<ecs::component_set<overlap_component<N>>>()...);
+
+    auto& main_pool = *std::get<0>(pools);
+    std::vector<ecs::entity> others;
+    for (auto ent = 0u; ent < count; ++ent) {
+        if (ent < half) {
+            main_pool.emplace(ent, 1.f);
+        } else {
+            others.push_back(ent);
+        }
+    }
+    const auto fill = [&](auto& pool) {
+        if (static_cast<void*>(&pool) == static_cast<void*>(&main_pool)) {
+            return;
+        }
+        std::vector<ecs::entity> ents;
+        for (auto ent = 0u; ent < half; ++ent) {
+            if (rng() % 100 < overlap_pct) {
+                ents.push_back(ent);
+            }
+        }
+        std::shuffle(others.begin(), others.end(), rng);
+        ents.insert(ents.end(), others.begin(), others.begin() + (half - ents.size()));
+        std::shuffle(ents.begin(), ents.end(), rng);
+        for (const auto ent : ents) {
+            pool.emplace(ent, 1.f);
+        }
+    };
+    (fill(*std::get<N>(pools)), ...);
+
+    ecs::component_view<overlap_component<N>...> view{ std::get<N>(pools).get()... };
+    char name[64];
+
+    const f64_t iterate_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        for (const auto ent : view) {
+            sum += (view.template get<overlap_component<N>>(ent).value + ...);
+        }
+        do_not_optimize(sum);
+    });
+    snprintf(name, sizeof name, "view<%zu> %u%% overlap iterate", sizeof...(N), overlap_pct);
+    report(group, name, half, iterate_ns);
+
+    const f64_t each_ns = measure(repeats, [&] {
+        f32_t sum = 0;
+        view.each([&sum](const overlap_component<N>&... comp) {
+            sum += (comp.value + ...);
+        });
+        do_not_optimize(sum);
+    });
+    snprintf(name, sizeof name, "view<%zu> %u%% overlap batched each", sizeof...(N), overlap_pct);
+    report(group, name, half, each_ns);
+}
+
+void ecs_component_set() {
+    for (const auto count : entity_counts) {
+        char group[32];
+        snprintf(group, sizeof group, "ecs n=%llu", static_cast<unsigned long long>(count));
+
+        component_set_ops(group, count);
+        view_ops(group, count);
+        registry_despawn(group, count);
+        registry_bulk(group, count);
+        registry_commands(group, count);
+        registry_snapshot(group, count);
+        for (const u32_t overlap : { 10u, 50u }) {
+            view_overlap(group, count, overlap, std::make_integer_sequence<u32_t, 3>{});
+            view_overlap(group, count, overlap, std::make_integer_sequence<u32_t, 4>{});
+        }
+    }
+}
+
+}
+
+DRY_BENCHMARK(ecs_component_set);
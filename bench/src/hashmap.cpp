@@ -0,0 +1,103 @@
+#include <random>
+#include <array>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+
+#include "bench.hpp"
+
+#include "util/trans_hashmap.hpp"
+
+using namespace dry;
+using namespace dry::bench;
+
+namespace {
+
+struct entry {
+    u32_t key;
+    u32_t payload;
+};
+
+// what dry::hashmap used to be
+template<typename Main, typename Hashed, auto Hasher>
+using node_hashmap = std::unordered_set<Main,
+    transparent_hasher<Main, Hashed, Hasher>,
+    transparent_comparator<Main, Hashed, Hasher>
+>;
+
+constexpr std::array key_counts{ 1'000ull, 10'000ull, 100'000ull, 1'000'000ull };
+constexpr u32_t repeats = 10;
+
+template<typename Map>
+void run(const char* name, const std::vector<u32_t>& keys, const std::vector<u32_t>& misses) {
+    char group[32];
+    snprintf(group, sizeof group, "hashmap n=%llu", static_cast<unsigned long long>(keys.size()));
+
+    const f64_t insert_ns = measure(repeats, [&] {
+        Map map;
+        for (const auto key : keys) {
+            map.insert(entry{ key, key });
+        }
+        do_not_optimize(map);
+    });
+    report(group, std::string{ name } + " insert", keys.size(), insert_ns);
+
+    Map map;
+    for (const auto key : keys) {
+        map.insert(entry{ key, key });
+    }
+
+    const f64_t hit_ns = measure(repeats, [&] {
+        u64_t sum = 0;
+        for (const auto key : keys) {
+            sum += map.find(key)->payload;
+        }
+        do_not_optimize(sum);
+    });
+    report(group, std::string{ name } + " find_hit", keys.size(), hit_ns);
+
+    const f64_t miss_ns = measure(repeats, [&] {
+        u64_t found = 0;
+        for (const auto key : misses) {
+            found += map.contains(key);
+        }
+        do_not_optimize(found);
+    });
+    report(group, std::string{ name } + " find_miss", misses.size(), miss_ns);
+
+    const f64_t erase_ns = measure(1, [&] {
+        for (const auto key : keys) {
+            // NOTE : transparent erase by key is C++23 for std containers
+            map.erase(map.find(key));
+        }
+        do_not_optimize(map);
+    });
+    report(group, std::string{ name } + " erase", keys.size(), erase_ns);
+}
+
+void hashmap_lookup() {
+    for (const auto count : key_counts) {
+        std::mt19937 rng{ static_cast<u32_t>(count) };
+        // even keys are present, odd keys miss
+        std::vector<u32_t> keys(count);
+        std::vector<u32_t> misses(count);
+        for (auto i = 0ull; i < count; ++i) {
+            const u32_t key = rng() & ~1u;
+            keys[i] = key;
+            misses[i] = key | 1u;
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        std::shuffle(keys.begin(), keys.end(), rng);
+        std::shuffle(misses.begin(), misses.end(), rng);
+
+        run<node_hashmap<entry, u32_t, &entry::key>>("unordered_set", keys, misses);
+        run<hashmap<entry, u32_t, &entry::key>>("flat", keys, misses);
+    }
+}
+
+}
+
+DRY_BENCHMARK(hashmap_lookup);
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <string>
+
+#include "bench.hpp"
+
+namespace dry::bench {
+
+namespace {
+
+struct result {
+    std::string benchmark;
+    std::string group;
+    std::string name;
+    u64_t element_count;
+    f64_t ns;
+};
+
+bool json_output = false;
+std::string_view current_benchmark;
+std::vector<result> results;
+
+void print_json_string(std::string_view str) {
+    putchar('"');
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            putchar('\\');
+        }
+        putchar(c);
+    }
+    putchar('"');
+}
+
+void print_json() {
+    printf("{\n  \"results\": [");
+    for (auto i = 0ull; i < results.size(); ++i) {
+        const auto& res = results[i];
+        printf(i == 0 ? "\n    {" : ",\n    {");
+        printf("\"benchmark\": ");
+        print_json_string(res.benchmark);
+        printf(", \"group\": ");
+        print_json_string(res.group);
+        printf(", \"name\": ");
+        print_json_string(res.name);
+        printf(", \"elements\": %llu, \"total_ns\": %.3f, \"ns_per_element\": %.6f}",
+            static_cast<unsigned long long>(res.element_count), res.ns, res.ns / res.element_count
+        );
+    }
+    printf("\n  ]\n}\n");
+}
+
+}
+
+std::vector<benchmark_entry>& benchmarks() {
+    static std::vector<benchmark_entry> entries;
+    return entries;
+}
+
+void report(std::string_view group, std::string_view name, u64_t element_count, f64_t ns) {
+    if (json_output) {
+        results.push_back({ std::string{ current_benchmark }, std::string{ group }, std::string{ name }, element_count, ns });
+        return;
+    }
+    printf("%-24.*s %-28.*s %10llu %12.3f ns/el\n",
+        static_cast<int>(group.size()), group.data(), static_cast<int>(name.size()), name.data(),
+        static_cast<unsigned long long>(element_count), ns / element_count
+    );
+}
+
+}
+
+// usage: dry_bench [--json] [filter], runs benchmarks with filter in their name
+// --json prints one document with every result at the end instead of a table
+int main(int argc, char** argv) {
+    std::string_view filter = "";
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--json") {
+            dry::bench::json_output = true;
+        } else {
+            filter = arg;
+        }
+    }
+
+    for (const auto& entry : dry::bench::benchmarks()) {
+        if (entry.name.find(filter) != std::string_view::npos) {
+            dry::bench::current_benchmark = entry.name;
+            entry.fun();
+        }
+    }
+
+    if (dry::bench::json_output) {
+        dry::bench::print_json();
+    }
+    return 0;
+}
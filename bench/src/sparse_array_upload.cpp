@@ -0,0 +1,74 @@
+#include <random>
+#include <array>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+
+#include "bench.hpp"
+
+#include "util/sparse_array.hpp"
+
+using namespace dry;
+using namespace dry::bench;
+
+namespace {
+
+// same footprint as instanced_pass::instance_input
+struct alignas(16) instance_input {
+    f32_t model[16];
+    u32_t material;
+};
+
+constexpr std::array instance_counts{ 10'000ull, 100'000ull, 1'000'000ull };
+// fraction of removed slots, mimics a scene after spawns and despawns
+constexpr std::array hole_ratios{ 0.0, 0.01, 0.1 };
+constexpr u32_t repeats = 20;
+
+sparse_array<instance_input> make_instances(u64_t count, f64_t hole_ratio) {
+    sparse_array<instance_input> ret{ count };
+    for (auto i = 0ull; i < count; ++i) {
+        ret.emplace(instance_input{ .model{}, .material = static_cast<u32_t>(i) });
+    }
+
+    std::mt19937_64 rng{ count };
+    std::uniform_int_distribution<u64_t> distr{ 0, count - 1 };
+    for (auto i = 0ull; i < static_cast<u64_t>(count * hole_ratio); ++i) {
+        const auto ind = distr(rng);
+        if (ret.contains(ind)) {
+            ret.remove(ind);
+        }
+    }
+    return ret;
+}
+
+void sparse_array_upload() {
+    for (const auto hole_ratio : hole_ratios) {
+        for (const auto count : instance_counts) {
+            const auto instances = make_instances(count, hole_ratio);
+            std::vector<instance_input> staging(count);
+
+            char group[32];
+            snprintf(group, sizeof group, "upload holes=%.2f", hole_ratio);
+
+            const f64_t iter_ns = measure(repeats, [&] {
+                std::copy(instances.begin(), instances.end(), staging.data());
+                do_not_optimize(staging);
+            });
+            report(group, "iterator_copy", instances.size(), iter_ns);
+
+            const f64_t run_ns = measure(repeats, [&] {
+                u64_t offset = 0;
+                instances.for_each_run([&](std::span<const instance_input> run) {
+                    std::memcpy(staging.data() + offset, run.data(), run.size_bytes());
+                    offset += run.size();
+                });
+                do_not_optimize(staging);
+            });
+            report(group, "run_memcpy", instances.size(), run_ns);
+        }
+    }
+}
+
+}
+
+DRY_BENCHMARK(sparse_array_upload);
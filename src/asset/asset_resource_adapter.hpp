@@ -3,6 +3,8 @@
 #ifndef DRY_ASSET_ASSET_RESOURCE_ADAPTER_H
 #define DRY_ASSET_ASSET_RESOURCE_ADAPTER_H
 
+#include "util/trans_hashmap.hpp"
+
 #include "assetreg.hpp"
 #include "graphics/renderer.hpp"
 
@@ -28,12 +30,12 @@ private:
     template<typename Asset>
     struct resource_binding;
 
-    using backref_map = std::unordered_map<index_type, hash_t>;
+    using backref_map = flat_map<index_type, hash_t>;
 
     asset_registry* _asset_reg = nullptr;
     vulkan_renderer* _renderer = nullptr;
 
-    std::unordered_map<hash_t, index_type> _renderer_asset_map;
+    flat_map<hash_t, index_type> _renderer_asset_map;
 
     backref_map _texture_backref;
     backref_map _mesh_backref;
@@ -4,6 +4,7 @@
 #define DRY_ASSETREG_H
 
 #include <unordered_map>
+#include <memory_resource>
 #include <any>
 
 #include "util/type.hpp"
@@ -24,12 +25,16 @@ struct is_hashed_asset<hashed_asset<T>> : std::true_type {
 // NOTE : hash map references have to be persistent
 class asset_registry final {
 public:
-    asset_registry() = default;
+    // NOTE : only the pools live in the resource, asset payloads allocate on their own
+    explicit asset_registry(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _resource{ resource },
+        _runtime_asset_indices{ 0, resource }
+    {}
     asset_registry(const asset_registry&) = delete;
     asset_registry& operator=(const asset_registry&) = delete;
 
     template<class T>
-    using hashmap_pool = std::unordered_map<hash_t, T>;
+    using hashmap_pool = std::pmr::unordered_map<hash_t, T>;
     template<class T>
     using asset_type_id = util::type_id<T, asset_registry>;
     // TODO : string_view overload please
@@ -51,7 +56,8 @@ public:
     template<typename Asset, typename... Ts> requires is_hashed_asset<Asset>::value
     const Asset& create(Ts&&... args);
 
-    void unload_all() { _asset_pools.clear(); }
+    // drops every pool, after this the resource holds nothing of the registry
+    void unload_all();
 
 private:
     template<typename Asset>
@@ -59,6 +65,7 @@ private:
 
     filesystem _filesys;
 
+    std::pmr::memory_resource* _resource;
     std::vector<std::any> _asset_pools;
     // TODO: sparse type
     sparse_table<u64_t> _runtime_asset_indices;
@@ -68,6 +75,11 @@ private:
 
 
 
+inline void asset_registry::unload_all() {
+    _asset_pools.clear();
+    _runtime_asset_indices = sparse_table<u64_t>{ 0, _resource };
+}
+
 template<typename Asset> requires is_hashed_asset<Asset>::value
 Asset& asset_registry::get(hash_t hash) {
     static const auto t_id = asset_type_id<Asset>::value();
@@ -176,7 +188,7 @@ void asset_registry::assure_pool_size() {
 
     if (t_id >= _asset_pools.size()) {
         _asset_pools.resize(t_id + 1);
-        _asset_pools[t_id] = hashmap_pool<Asset>{};
+        _asset_pools[t_id] = hashmap_pool<Asset>{ _resource };
     }
 }
 
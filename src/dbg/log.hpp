@@ -5,6 +5,8 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <exception>
 #include <string_view>
 
 #include "util/num.hpp"
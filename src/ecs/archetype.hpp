@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+#include "util/type.hpp"
+#include "util/trans_hashmap.hpp"
+#include "util/thread_pool.hpp"
+#include "dbg/log.hpp"
+
+#include "entity.hpp"
+#include "component_mask.hpp"
+
+namespace dry::ecs {
+
+// what an archetype needs to move and destroy a column it knows nothing about
+struct component_info {
+    uint32_t id;
+    uint32_t size;
+    uint32_t align;
+    // move constructs into dst and destroys src
+    void(*relocate)(void* dst, void* src);
+    void(*destroy)(void* ptr);
+};
+
+// entities with the same component mask, stored in fixed size chunks
+// each chunk is [entities | column 0 | column 1 | ...], one plain array per component
+class archetype {
+public:
+    static constexpr uint32_t chunk_bytes = 16 * 1024;
+    static constexpr uint32_t chunk_align = 64;
+
+    struct chunk {
+        std::byte* data;
+        uint32_t count;
+    };
+    struct column {
+        component_info info;
+        uint32_t offset;
+    };
+
+    archetype(const component_mask& mask, std::vector<component_info> infos, std::pmr::memory_resource* resource) :
+        _mask{ mask },
+        _resource{ resource }
+    {
+        std::sort(infos.begin(), infos.end(), [](const auto& l, const auto& r) { return l.id < r.id; });
+
+        uint32_t row_bytes = sizeof(entity);
+        uint32_t align_slack = 0;
+        for (const auto& info : infos) {
+            row_bytes += info.size;
+            align_slack += info.align;
+        }
+        // oversized components still get at least one row per chunk
+        _chunk_capacity = (std::max)((chunk_bytes - (std::min)(align_slack, chunk_bytes)) / row_bytes, 1u);
+
+        uint32_t offset = sizeof(entity) * _chunk_capacity;
+        for (const auto& info : infos) {
+            offset = (offset + info.align - 1) / info.align * info.align;
+            _columns.push_back({ info, offset });
+            offset += info.size * _chunk_capacity;
+        }
+        _chunk_size = (std::max)(offset, chunk_bytes);
+    }
+    archetype(const archetype&) = delete;
+    archetype& operator=(const archetype&) = delete;
+
+    ~archetype() {
+        for (auto& ch : _chunks) {
+            for (const auto& col : _columns) {
+                for (auto row = 0u; row < ch.count; ++row) {
+                    col.info.destroy(ch.data + col.offset + row * col.info.size);
+                }
+            }
+            _resource->deallocate(ch.data, _chunk_size, chunk_align);
+        }
+    }
+
+    const component_mask& mask() const noexcept {
+        return _mask;
+    }
+    uint32_t chunk_capacity() const noexcept {
+        return _chunk_capacity;
+    }
+    std::vector<chunk>& chunks() noexcept {
+        return _chunks;
+    }
+    uint32_t size() const noexcept {
+        return _size;
+    }
+
+    // column position of a component id, -1 if not stored here
+    int32_t column_index(uint32_t id) const noexcept {
+        for (auto i = 0u; i < _columns.size(); ++i) {
+            if (_columns[i].info.id == id) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        return -1;
+    }
+    const column& column_at(uint32_t index) const noexcept {
+        return _columns[index];
+    }
+    uint32_t column_count() const noexcept {
+        return static_cast<uint32_t>(_columns.size());
+    }
+
+    entity* entities(chunk& ch) const noexcept {
+        return reinterpret_cast<entity*>(ch.data);
+    }
+    void* component(chunk& ch, uint32_t column_ind, uint32_t row) const noexcept {
+        return ch.data + _columns[column_ind].offset + row * _columns[column_ind].info.size;
+    }
+    template<typename Component>
+    Component* column_data(chunk& ch, uint32_t column_ind) const noexcept {
+        return std::launder(reinterpret_cast<Component*>(ch.data + _columns[column_ind].offset));
+    }
+
+    // appends a row with only the entity set, the caller constructs every column
+    std::pair<uint32_t, uint32_t> push(entity ent) {
+        if (_chunks.empty() || _chunks.back().count == _chunk_capacity) {
+            _chunks.push_back({ static_cast<std::byte*>(_resource->allocate(_chunk_size, chunk_align)), 0 });
+        }
+        chunk& ch = _chunks.back();
+        entities(ch)[ch.count] = ent;
+        _size += 1;
+        return { static_cast<uint32_t>(_chunks.size() - 1), ch.count++ };
+    }
+    // columns of the row have to be destroyed or moved out already
+    // fills the hole with the last row, returns the entity that moved there or null_entity
+    entity erase(uint32_t chunk_ind, uint32_t row) {
+        chunk& last = _chunks.back();
+        const uint32_t last_row = last.count - 1;
+        entity moved = null_entity;
+
+        if (&_chunks[chunk_ind] != &last || row != last_row) {
+            chunk& ch = _chunks[chunk_ind];
+            for (auto col = 0u; col < _columns.size(); ++col) {
+                _columns[col].info.relocate(component(ch, col, row), component(last, col, last_row));
+            }
+            moved = entities(last)[last_row];
+            entities(ch)[row] = moved;
+        }
+
+        last.count -= 1;
+        _size -= 1;
+        if (last.count == 0) {
+            _resource->deallocate(last.data, _chunk_size, chunk_align);
+            _chunks.pop_back();
+        }
+        return moved;
+    }
+
+    // cached transitions when a component id is attached or detached
+    flat_map<uint32_t, uint32_t> add_edges;
+    flat_map<uint32_t, uint32_t> remove_edges;
+
+private:
+    component_mask _mask;
+    std::pmr::memory_resource* _resource;
+    std::vector<column> _columns;
+    std::vector<chunk> _chunks;
+    uint32_t _chunk_capacity = 0;
+    uint32_t _chunk_size = 0;
+    uint32_t _size = 0;
+};
+
+// alternative to ec_registry for systems that touch several components per entity
+// queries walk matching chunks linearly, no per entity membership tests,
+// attach and detach move the entity between archetypes instead
+class archetype_registry {
+    template<typename T>
+    using component_type_id = util::type_id<T, archetype_registry>;
+
+public:
+    explicit archetype_registry(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _resource{ resource },
+        _entities{ resource },
+        _locations{ resource }
+    {
+        archetype_for(component_mask{});
+    }
+    archetype_registry(const archetype_registry&) = delete;
+    archetype_registry& operator=(const archetype_registry&) = delete;
+
+    entity create() {
+        assert_unlocked();
+        const entity ent = _entities.create();
+        if (entity_index(ent) >= _locations.size()) {
+            _locations.resize(entity_index(ent) + 1);
+        }
+        const auto [chunk_ind, row] = _archetypes[0]->push(ent);
+        _locations[entity_index(ent)] = { 0, chunk_ind, row };
+        return ent;
+    }
+    void destroy(entity ent) {
+        assert_unlocked();
+        const location loc = _locations[entity_index(ent)];
+        archetype& arch = *_archetypes[loc.archetype];
+
+        auto& ch = arch.chunks()[loc.chunk];
+        for (auto col = 0u; col < arch.column_count(); ++col) {
+            arch.column_at(col).info.destroy(arch.component(ch, col, loc.row));
+        }
+        erase_row(loc);
+        _entities.destroy(ent);
+    }
+    bool valid(entity ent) const noexcept {
+        return _entities.valid(ent);
+    }
+    uint32_t alive() const noexcept {
+        return _entities.alive();
+    }
+    uint32_t archetype_count() const noexcept {
+        return static_cast<uint32_t>(_archetypes.size());
+    }
+
+    // NOTE : the entity must not have Component yet, panics otherwise
+    template<typename Component, typename... Args>
+    Component& attach(entity ent, Args&&... args) {
+        assert_unlocked();
+        const uint32_t id = register_component<Component>();
+        const location loc = _locations[entity_index(ent)];
+        if (_archetypes[loc.archetype]->mask().test(id)) {
+            LOG_ERR("Entity %u already has component %u", ent, id);
+            dbg::panic();
+        }
+
+        const uint32_t target = transition(loc.archetype, id, true);
+        const location new_loc = move_entity(ent, loc, target);
+
+        archetype& arch = *_archetypes[target];
+        void* ptr = arch.component(arch.chunks()[new_loc.chunk], arch.column_index(id), new_loc.row);
+        if constexpr (std::is_aggregate_v<Component>) {
+            return *new (ptr) Component{ std::forward<Args>(args)... };
+        } else {
+            return *new (ptr) Component(std::forward<Args>(args)...);
+        }
+    }
+    template<typename Component>
+    void detach(entity ent) {
+        assert_unlocked();
+        const uint32_t id = component_type_id<Component>::value();
+        const location loc = _locations[entity_index(ent)];
+        // moving into its own archetype would leave the location pointing at a popped row
+        if (id >= component_mask::max_components || !_archetypes[loc.archetype]->mask().test(id)) {
+            return;
+        }
+        move_entity(ent, loc, transition(loc.archetype, id, false));
+    }
+    template<typename Component>
+    bool has(entity ent) const noexcept {
+        return _archetypes[_locations[entity_index(ent)].archetype]->mask().test(component_type_id<Component>::value());
+    }
+    template<typename Component>
+    Component& get(entity ent) noexcept {
+        const location loc = _locations[entity_index(ent)];
+        archetype& arch = *_archetypes[loc.archetype];
+        const auto col = static_cast<uint32_t>(arch.column_index(component_type_id<Component>::value()));
+        return arch.column_data<Component>(arch.chunks()[loc.chunk], col)[loc.row];
+    }
+
+    // fun(count, entities, Component*...) once per matching chunk, columns are plain arrays
+    template<typename... Component, typename Fun>
+    void each_chunk(Fun fun) {
+        component_mask query;
+        (query.set(register_component<Component>()), ...);
+
+        for (auto& arch_ptr : _archetypes) {
+            archetype& arch = *arch_ptr;
+            if (arch.size() == 0 || !arch.mask().contains_all(query)) {
+                continue;
+            }
+            const uint32_t columns[] = { static_cast<uint32_t>(arch.column_index(component_type_id<Component>::value()))..., 0 };
+            for (auto& ch : arch.chunks()) {
+                call_chunk<Component...>(fun, arch, ch, columns, std::index_sequence_for<Component...>{});
+            }
+        }
+    }
+    // fun(Component&...) or fun(entity, Component&...) for every entity that has all of them
+    template<typename... Component, typename Fun>
+    void each(Fun fun) {
+        each_chunk<Component...>([&fun](uint32_t count, const entity* ents, Component*... cols) {
+            for (auto row = 0u; row < count; ++row) {
+                if constexpr (std::is_invocable_v<Fun, entity, Component&...>) {
+                    fun(ents[row], cols[row]...);
+                } else {
+                    fun(cols[row]...);
+                }
+            }
+        });
+    }
+
+    // each() with matching chunks spread over the thread pool, one task per chunk range
+    // NOTE : no create, destroy, attach or detach until it returns, asserted in debug
+    template<typename... Component, typename Fun>
+    void par_each(Fun fun, thread_pool& pool = thread_pool::global()) {
+        component_mask query;
+        (query.set(register_component<Component>()), ...);
+
+        struct chunk_ref {
+            archetype* arch;
+            archetype::chunk* ch;
+        };
+        std::vector<chunk_ref> chunks;
+        for (auto& arch_ptr : _archetypes) {
+            if (arch_ptr->size() == 0 || !arch_ptr->mask().contains_all(query)) {
+                continue;
+            }
+            for (auto& ch : arch_ptr->chunks()) {
+                chunks.push_back({ arch_ptr.get(), &ch });
+            }
+        }
+
+        lock_structure();
+        pool.parallel_for(chunks.size(), 1, [&chunks, &fun](u64_t beg, u64_t end) {
+            for (; beg < end; ++beg) {
+                archetype& arch = *chunks[beg].arch;
+                archetype::chunk& ch = *chunks[beg].ch;
+                const entity* ents = arch.entities(ch);
+                auto arrays = std::make_tuple(
+                    arch.column_data<Component>(ch, static_cast<uint32_t>(arch.column_index(component_type_id<Component>::value())))...
+                );
+                for (auto row = 0u; row < ch.count; ++row) {
+                    if constexpr (std::is_invocable_v<Fun, entity, Component&...>) {
+                        fun(ents[row], std::get<Component*>(arrays)[row]...);
+                    } else {
+                        fun(std::get<Component*>(arrays)[row]...);
+                    }
+                }
+            }
+        });
+        unlock_structure();
+    }
+
+private:
+    struct location {
+        uint32_t archetype;
+        uint32_t chunk;
+        uint32_t row;
+    };
+
+    void lock_structure() noexcept {
+#ifdef DEBUG
+        _structure_locks.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+    void unlock_structure() noexcept {
+#ifdef DEBUG
+        _structure_locks.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    }
+    void assert_unlocked() const noexcept {
+#ifdef DEBUG
+        assert(_structure_locks.load(std::memory_order_relaxed) == 0 && "structural change during par_each");
+#endif
+    }
+
+    template<typename Component>
+    uint32_t register_component() {
+        const uint32_t id = component_type_id<Component>::value();
+        if (id >= component_mask::max_components) {
+            LOG_ERR("Too many component types, component_mask holds %u", component_mask::max_components);
+            dbg::panic();
+        }
+        if (id >= _infos.size()) {
+            _infos.resize(id + 1);
+        }
+        _infos[id] = {
+            .id = id,
+            .size = sizeof(Component),
+            .align = alignof(Component),
+            .relocate = [](void* dst, void* src) {
+                auto* src_comp = std::launder(static_cast<Component*>(src));
+                new (dst) Component(std::move(*src_comp));
+                src_comp->~Component();
+            },
+            .destroy = [](void* ptr) { std::launder(static_cast<Component*>(ptr))->~Component(); }
+        };
+        return id;
+    }
+
+    template<typename... Component, typename Fun, size_t... Ind>
+    static void call_chunk(Fun& fun, archetype& arch, archetype::chunk& ch, const uint32_t* columns, std::index_sequence<Ind...>) {
+        fun(ch.count, static_cast<const entity*>(arch.entities(ch)), arch.column_data<Component>(ch, columns[Ind])...);
+    }
+
+    uint32_t archetype_for(const component_mask& mask) {
+        if (auto it = _archetype_index.find(mask); it != _archetype_index.end()) {
+            return it->second;
+        }
+
+        std::vector<component_info> infos;
+        mask.for_each([this, &infos](uint32_t id) { infos.push_back(_infos[id]); });
+
+        const auto ind = static_cast<uint32_t>(_archetypes.size());
+        _archetypes.push_back(std::make_unique<archetype>(mask, std::move(infos), _resource));
+        _archetype_index[mask] = ind;
+        return ind;
+    }
+    // archetype reached by adding or removing id, cached on the edges
+    uint32_t transition(uint32_t from, uint32_t id, bool add) {
+        auto& edges = add ? _archetypes[from]->add_edges : _archetypes[from]->remove_edges;
+        if (auto it = edges.find(id); it != edges.end()) {
+            return it->second;
+        }
+
+        component_mask mask = _archetypes[from]->mask();
+        if (add) {
+            mask.set(id);
+        } else {
+            mask.reset(id);
+        }
+        const uint32_t target = archetype_for(mask);
+        // NOTE : archetype_for may grow _archetypes, can't reuse the edges reference
+        (add ? _archetypes[from]->add_edges : _archetypes[from]->remove_edges)[id] = target;
+        return target;
+    }
+    // relocates shared columns, destroys the ones target doesn't have
+    location move_entity(entity ent, location loc, uint32_t target) {
+        archetype& src = *_archetypes[loc.archetype];
+        archetype& dst = *_archetypes[target];
+
+        const auto [chunk_ind, row] = dst.push(ent);
+        auto& src_chunk = src.chunks()[loc.chunk];
+        auto& dst_chunk = dst.chunks()[chunk_ind];
+
+        for (auto col = 0u; col < src.column_count(); ++col) {
+            void* src_ptr = src.component(src_chunk, col, loc.row);
+            const int32_t dst_col = dst.column_index(src.column_at(col).info.id);
+            if (dst_col >= 0) {
+                src.column_at(col).info.relocate(dst.component(dst_chunk, dst_col, row), src_ptr);
+            } else {
+                src.column_at(col).info.destroy(src_ptr);
+            }
+        }
+        erase_row(loc);
+
+        const location new_loc{ target, chunk_ind, row };
+        _locations[entity_index(ent)] = new_loc;
+        return new_loc;
+    }
+    void erase_row(location loc) {
+        const entity moved = _archetypes[loc.archetype]->erase(loc.chunk, loc.row);
+        if (moved != null_entity) {
+            _locations[entity_index(moved)] = loc;
+        }
+    }
+
+    std::pmr::memory_resource* _resource;
+    entity_allocator _entities;
+    std::pmr::vector<location> _locations;
+    std::vector<component_info> _infos;
+    std::vector<std::unique_ptr<archetype>> _archetypes;
+    flat_map<component_mask, uint32_t, component_mask_hash> _archetype_index;
+#ifdef DEBUG
+    std::atomic<uint32_t> _structure_locks{ 0 };
+#endif
+};
+
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "util/num.hpp"
+
+#include "ecs.hpp"
+
+namespace dry::ecs {
+
+// records structural changes without touching the pools, apply() replays them in one batch
+// grouped by component type, every pool gets a single reserve and a single removal pass
+// NOTE : per type attaches land before detaches and destroys come last,
+// the order the commands were recorded in is not kept
+class command_buffer {
+public:
+    explicit command_buffer(ec_registry& registry) :
+        _registry{ &registry }
+    {}
+
+    // usable in later commands of any buffer of the registry right away
+    entity create() noexcept {
+        return _registry->reserve();
+    }
+    void destroy(entity ent) {
+        _destroyed.push_back(ent);
+    }
+    template<typename Component, typename... Args>
+    void attach(entity ent, Args&&... args) {
+        // same split as component_set::emplace, braces would pick an initializer_list constructor
+        if constexpr (std::is_aggregate_v<Component>) {
+            assure<Component>().attached.emplace_back(ent, Component{ std::forward<Args>(args)... });
+        } else {
+            assure<Component>().attached.emplace_back(std::piecewise_construct,
+                std::forward_as_tuple(ent), std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+    }
+    template<typename Component>
+    void detach(entity ent) {
+        assure<Component>().detached.push_back(ent);
+    }
+
+    bool empty() const noexcept;
+    // not thread safe, nothing may record or touch the registry meanwhile
+    void apply();
+
+private:
+    friend class command_queue;
+
+    struct pending_base {
+        virtual ~pending_base() = default;
+        // every buffer's pending list of the same type, this one included
+        virtual void apply_attached(ec_registry& registry, pending_base* const* all, uint32_t count) = 0;
+        virtual void apply_detached(ec_registry& registry, pending_base* const* all, uint32_t count) = 0;
+        virtual bool empty() const noexcept = 0;
+        virtual void clear() noexcept = 0;
+
+        std::vector<entity> detached;
+    };
+    template<typename Component>
+    struct pending;
+
+    template<typename Component>
+    pending<Component>& assure();
+
+    static void apply(ec_registry& registry, command_buffer* const* buffers, uint32_t count);
+    void clear() noexcept;
+
+    ec_registry* _registry;
+    std::vector<entity> _destroyed;
+    // indexed by the registry's component id
+    std::vector<std::unique_ptr<pending_base>> _pending;
+};
+
+// one command_buffer per thread that records into it, apply() merges all of them
+class command_queue {
+public:
+    explicit command_queue(ec_registry& registry) :
+        _registry{ &registry },
+        _id{ next_id() }
+    {}
+    command_queue(const command_queue&) = delete;
+    command_queue& operator=(const command_queue&) = delete;
+
+    // the calling thread's buffer, created on first use
+    command_buffer& local();
+    // not thread safe, call at a sync point once the recording threads are done
+    void apply();
+
+private:
+    static u64_t next_id() noexcept {
+        static std::atomic<u64_t> counter{ 0 };
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ec_registry* _registry;
+    // ids are never reused so a stale thread_local entry can't alias a newer queue
+    u64_t _id;
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<command_buffer>> _buffers;
+};
+
+
+
+// impl
+template<typename Component>
+struct command_buffer::pending : pending_base {
+    void apply_attached(ec_registry& registry, pending_base* const* all, uint32_t count) override {
+        auto& pool = registry.assure<Component>();
+        const auto component_id = ec_registry::component_type_id<Component>::value();
+
+        auto total = pool.size();
+        for (auto i = 0u; i < count; ++i) {
+            total += static_cast<uint32_t>(static_cast<pending*>(all[i])->attached.size());
+        }
+        pool.reserve(total);
+
+        for (auto i = 0u; i < count; ++i) {
+            for (auto& [ent, component] : static_cast<pending*>(all[i])->attached) {
+                if (!registry.valid(ent) || registry._masks[entity_index(ent)].test(component_id)) {
+                    continue;
+                }
+                pool.emplace(ent, std::move(component));
+                registry._masks[entity_index(ent)].set(component_id);
+            }
+        }
+    }
+    void apply_detached(ec_registry& registry, pending_base* const* all, uint32_t count) override {
+        auto& pool = registry.assure<Component>();
+        const auto component_id = ec_registry::component_type_id<Component>::value();
+
+        // testing and resetting the mask bit also drops duplicates
+        std::vector<entity> removed;
+        for (auto i = 0u; i < count; ++i) {
+            for (const auto ent : all[i]->detached) {
+                if (registry.valid(ent) && registry._masks[entity_index(ent)].test(component_id)) {
+                    registry._masks[entity_index(ent)].reset(component_id);
+                    removed.push_back(ent);
+                }
+            }
+        }
+        pool.remove_batch(removed.data(), static_cast<uint32_t>(removed.size()));
+    }
+    bool empty() const noexcept override {
+        return attached.empty() && detached.empty();
+    }
+    void clear() noexcept override {
+        attached.clear();
+        detached.clear();
+    }
+
+    std::vector<std::pair<entity, Component>> attached;
+};
+
+template<typename Component>
+command_buffer::pending<Component>& command_buffer::assure() {
+    const auto component_id = ec_registry::component_type_id<Component>::value();
+    if (component_id >= component_mask::max_components) {
+        LOG_ERR("Too many component types, component_mask holds %u", component_mask::max_components);
+        dbg::panic();
+    }
+
+    if (component_id >= _pending.size()) {
+        _pending.resize(component_id + 1);
+    }
+    if (!_pending[component_id]) {
+        _pending[component_id] = std::make_unique<pending<Component>>();
+    }
+    return *static_cast<pending<Component>*>(_pending[component_id].get());
+}
+
+inline bool command_buffer::empty() const noexcept {
+    if (!_destroyed.empty()) {
+        return false;
+    }
+    for (const auto& pend : _pending) {
+        if (pend && !pend->empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void command_buffer::apply() {
+    command_buffer* self = this;
+    apply(*_registry, &self, 1);
+}
+
+inline void command_buffer::apply(ec_registry& registry, command_buffer* const* buffers, uint32_t count) {
+    registry.flush_reserved();
+
+    u64_t type_count = 0;
+    for (auto i = 0u; i < count; ++i) {
+        type_count = (std::max)(type_count, u64_t{ buffers[i]->_pending.size() });
+    }
+
+    // ascending component id, each type sees the pending lists of every buffer at once
+    std::vector<pending_base*> same_type;
+    for (auto id = 0u; id < type_count; ++id) {
+        same_type.clear();
+        for (auto i = 0u; i < count; ++i) {
+            auto& pend = buffers[i]->_pending;
+            if (id < pend.size() && pend[id] && !pend[id]->empty()) {
+                same_type.push_back(pend[id].get());
+            }
+        }
+        if (same_type.empty()) {
+            continue;
+        }
+        const auto same_count = static_cast<uint32_t>(same_type.size());
+        same_type.front()->apply_attached(registry, same_type.data(), same_count);
+        same_type.front()->apply_detached(registry, same_type.data(), same_count);
+    }
+
+    std::vector<entity> destroyed;
+    for (auto i = 0u; i < count; ++i) {
+        destroyed.insert(destroyed.end(), buffers[i]->_destroyed.begin(), buffers[i]->_destroyed.end());
+    }
+    registry.destroy_range(destroyed.data(), static_cast<uint32_t>(destroyed.size()));
+
+    for (auto i = 0u; i < count; ++i) {
+        buffers[i]->clear();
+    }
+}
+
+inline void command_buffer::clear() noexcept {
+    _destroyed.clear();
+    for (auto& pend : _pending) {
+        if (pend) {
+            pend->clear();
+        }
+    }
+}
+
+inline command_buffer& command_queue::local() {
+    // NOTE : entries of destroyed queues stay behind, a few bytes per thread and queue
+    thread_local std::vector<std::pair<u64_t, command_buffer*>> cache;
+    for (const auto& [id, buffer] : cache) {
+        if (id == _id) {
+            return *buffer;
+        }
+    }
+
+    std::lock_guard lock{ _mutex };
+    auto* buffer = _buffers.emplace_back(std::make_unique<command_buffer>(*_registry)).get();
+    cache.emplace_back(_id, buffer);
+    return *buffer;
+}
+
+inline void command_queue::apply() {
+    std::vector<command_buffer*> buffers;
+    buffers.reserve(_buffers.size());
+    for (auto& buffer : _buffers) {
+        buffers.push_back(buffer.get());
+    }
+    command_buffer::apply(*_registry, buffers.data(), static_cast<uint32_t>(buffers.size()));
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+namespace dry::ecs {
+
+// set of component type ids, which pools an entity is in or what an archetype stores
+class component_mask {
+public:
+    static constexpr uint32_t max_components = 128;
+
+    void set(uint32_t id) noexcept {
+        _words[id / 64] |= uint64_t{ 1 } << (id % 64);
+    }
+    void reset(uint32_t id) noexcept {
+        _words[id / 64] &= ~(uint64_t{ 1 } << (id % 64));
+    }
+    bool test(uint32_t id) const noexcept {
+        return _words[id / 64] >> (id % 64) & 1;
+    }
+    void clear() noexcept {
+        _words.fill(0);
+    }
+    bool contains_all(const component_mask& oth) const noexcept {
+        for (auto word = 0u; word < _words.size(); ++word) {
+            if ((_words[word] & oth._words[word]) != oth._words[word]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    uint64_t hash() const noexcept {
+        uint64_t ret = 0;
+        for (const auto word : _words) {
+            ret = (ret ^ word) * 0x100000001b3ull;
+        }
+        return ret;
+    }
+
+    bool operator==(const component_mask&) const noexcept = default;
+
+    // fun(id) for every set bit, O(words + set bits)
+    template<typename Fun>
+    void for_each(Fun fun) const {
+        for (auto word = 0u; word < _words.size(); ++word) {
+            for (uint64_t bits = _words[word]; bits != 0; bits &= bits - 1) {
+                fun(word * 64 + static_cast<uint32_t>(std::countr_zero(bits)));
+            }
+        }
+    }
+
+private:
+    std::array<uint64_t, max_components / 64> _words{};
+};
+
+struct component_mask_hash {
+    size_t operator()(const component_mask& mask) const noexcept {
+        return static_cast<size_t>(mask.hash());
+    }
+};
+
+}
@@ -1,46 +1,342 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <limits>
+#include <atomic>
+#include <cassert>
+#include <numeric>
+#include <iterator>
+#include <type_traits>
+
+#include "dbg/log.hpp"
+
+#if defined(__AVX2__)
+  #define DRY_ECS_AVX2
+  #include <immintrin.h>
+#endif
+
+#include "entity.hpp"
+#include "sparse_page_pool.hpp"
 
 namespace dry::ecs {
 
-using entity = uint32_t;
-constexpr entity null_entity = std::numeric_limits<entity>::max();
+class entity_set;
+
+// sets owned by one group keep the entities they all share in the same [0, size) prefix
+// of their dense arrays, in the same order, see ec_registry::group
+struct owning_group_data {
+    std::vector<entity_set*> owned;
+    uint32_t size = 0;
+
+    // call after ent was added to one of the owned sets
+    void on_emplace(entity ent);
+    // call before ent is removed from one of the owned sets
+    void on_remove(entity ent);
+};
+
+// bytes a set holds, capacities rather than sizes
+struct pool_memory {
+    uint64_t sparse = 0;
+    uint64_t dense = 0;
+    uint64_t components = 0;
+
+    uint64_t total() const noexcept {
+        return sparse + dense + components;
+    }
+};
+
+// listeners as a function pointer plus context, publishing to none is a single empty check
+// NOTE : listeners may read the set but must not emplace into or remove from it
+class entity_signal {
+public:
+    using fun_type = void(*)(void* ctx, entity_set& set, entity ent);
+
+    void connect(fun_type fun, void* ctx = nullptr) {
+        _listeners.push_back({ fun, ctx });
+    }
+    // owner.Member(set, ent)
+    template<auto Member, typename Owner>
+    void connect(Owner& owner) {
+        connect([](void* ctx, entity_set& set, entity ent) {
+            (static_cast<Owner*>(ctx)->*Member)(set, ent);
+        }, &owner);
+    }
+    void disconnect(void* ctx) {
+        std::erase_if(_listeners, [ctx](const listener& lst) { return lst.ctx == ctx; });
+    }
+
+    bool empty() const noexcept {
+        return _listeners.empty();
+    }
+    void publish(entity_set& set, entity ent) const {
+        for (const auto& lst : _listeners) {
+            lst.fun(lst.ctx, set, ent);
+        }
+    }
+
+private:
+    struct listener {
+        fun_type fun;
+        void* ctx;
+    };
+
+    std::vector<listener> _listeners;
+};
 
 // TODO : no static polymorphism, resorting to regular virtual inheritance
+// NOTE : component_set is final, calls through it resolve the overrides statically
 class entity_set {
 public:
-    using iterator = std::vector<entity>::reverse_iterator;
-    using const_iterator = std::vector<entity>::const_reverse_iterator;
+    using iterator = std::pmr::vector<entity>::reverse_iterator;
+    using const_iterator = std::pmr::vector<entity>::const_reverse_iterator;
+
+    // sparse pages come from pages when given, straight from resource otherwise
+    explicit entity_set(std::pmr::memory_resource* resource = std::pmr::get_default_resource(), sparse_page_pool* pages = nullptr) :
+        _sparse_ent{ resource },
+        _bucket_live{ resource },
+        _dense_ent{ resource },
+        _ticks{ resource },
+        _pages{ pages }
+    {}
+    entity_set(const entity_set&) = delete;
+    entity_set& operator=(const entity_set&) = delete;
 
-    virtual ~entity_set() = default;
+    virtual ~entity_set() {
+        for (auto* bucket : _sparse_ent) {
+            if (bucket != nullptr) {
+                release_page(bucket);
+            }
+        }
+    }
 
+    // NOTE : the dense entity has to match, a stale version of a recycled index isn't contained
     bool contains(entity ent) const noexcept {
         const uint32_t bucket = bucket_index(ent);
-        return bucket < _sparse_ent.size() && _sparse_ent[bucket] && _sparse_ent[bucket][bucket_offset(ent)] != null_entity;
+        if (bucket >= _sparse_ent.size() || !_sparse_ent[bucket]) {
+            return false;
+        }
+        const entity dense_ind = _sparse_ent[bucket][bucket_offset(ent)];
+        return dense_ind != null_entity && _dense_ent[dense_ind] == ent;
     }
+    // bit i set when ents[i] is contained, reads all of ents[0, batch_width)
+    // gathers the sparse and dense entries with avx2, branch free so partly overlapping
+    // sets don't pay a mispredict per entity, one contains() after another without it
+    static constexpr uint32_t batch_width = 8;
+#ifdef DRY_ECS_AVX2
+    static constexpr bool batch_native = true;
+#else
+    static constexpr bool batch_native = false;
+#endif
+    uint32_t contains_batch(const entity* ents) const noexcept;
+
     void emplace(entity ent) {
+        assert_unlocked();
         secure_bucket(bucket_index(ent))[bucket_offset(ent)] = static_cast<entity>(_dense_ent.size());
+        _bucket_live[bucket_index(ent)] += 1;
         _dense_ent.push_back(ent);
+        _ticks.push_back(_tick);
+
+        if (_group != nullptr) {
+            _group->on_emplace(ent);
+        }
+        if (!_on_construct.empty()) {
+            _on_construct.publish(*this, ent);
+        }
     }
     void remove(entity ent) {
-        // TODO : assume exists
-        entity& dense_ind = _sparse_ent[bucket_index(ent)][bucket_offset(ent)];
-        const entity back_ent = _dense_ent.back();
+        remove_component(remove_dense(ent));
+    }
+    // NOTE : none of ents may be contained yet, the components have to be appended beforehand
+    void emplace_range(const entity* ents, uint32_t count) {
+        assert_unlocked();
+        const auto first = static_cast<uint32_t>(_dense_ent.size());
+        _dense_ent.insert(_dense_ent.end(), ents, ents + count);
+        _ticks.insert(_ticks.end(), count, _tick);
 
-        std::swap(_dense_ent[dense_ind], _dense_ent.back());
-        _dense_ent.pop_back();
-        remove_component(dense_ind);
+        // sorted or freshly created entities mostly stay in one bucket for long runs
+        uint32_t bucket = null_entity;
+        bucket_t sparse = nullptr;
+        for (auto i = 0u; i < count; ++i) {
+            if (bucket_index(ents[i]) != bucket) {
+                bucket = bucket_index(ents[i]);
+                sparse = secure_bucket(bucket);
+            }
+            sparse[bucket_offset(ents[i])] = first + i;
+            _bucket_live[bucket] += 1;
+        }
 
-        _sparse_ent[bucket_index(back_ent)][bucket_offset(back_ent)] = dense_ind;
-        dense_ind = null_entity;
+        if (_group != nullptr) {
+            for (auto i = 0u; i < count; ++i) {
+                _group->on_emplace(ents[i]);
+            }
+        }
+        if (!_on_construct.empty()) {
+            for (auto i = 0u; i < count; ++i) {
+                _on_construct.publish(*this, ents[i]);
+            }
+        }
+    }
+
+    // one compacting pass once the batch is a sizeable part of the set, survivors keep their order
+    // NOTE : entities have to be contained and unique, grouped sets fall back to remove()
+    void remove_batch(const entity* ents, uint32_t count) {
+        assert_unlocked();
+        if (_group != nullptr || count * 8 < size()) {
+            for (auto i = 0u; i < count; ++i) {
+                remove(ents[i]);
+            }
+            return;
+        }
+        if (count == 0) {
+            return;
+        }
+
+        if (!_on_destroy.empty()) {
+            for (auto i = 0u; i < count; ++i) {
+                _on_destroy.publish(*this, ents[i]);
+            }
+        }
+
+        // dense positions sorted by marking them, linear where a sort of random input isn't
+        std::vector<bool> marked(_dense_ent.size());
+        auto first = size();
+        for (auto i = 0u; i < count; ++i) {
+            const entity dense_ind = index_of(ents[i]);
+            marked[dense_ind] = true;
+            first = (std::min)(first, dense_ind);
+            release_entry(ents[i]);
+        }
+        std::vector<uint32_t> removed;
+        removed.reserve(count);
+        for (auto i = first; i < marked.size(); ++i) {
+            if (marked[i]) {
+                removed.push_back(i);
+            }
+        }
+
+        erase_sorted(_dense_ent, removed);
+        erase_sorted(_ticks, removed);
+        erase_components(removed);
+        for (auto i = removed.front(); i < _dense_ent.size(); ++i) {
+            _sparse_ent[bucket_index(_dense_ent[i])][bucket_offset(_dense_ent[i])] = i;
+        }
+    }
+    virtual void reserve(uint32_t count) {
+        _dense_ent.reserve(count);
+        _ticks.reserve(count);
+    }
+    uint32_t sparse_pages() const noexcept {
+        uint32_t ret = 0;
+        for (const auto* bucket : _sparse_ent) {
+            ret += bucket != nullptr;
+        }
+        return ret;
+    }
+    virtual pool_memory memory_usage() const noexcept {
+        return {
+            .sparse = uint64_t{ sparse_pages() } * BUCKET_CAP + _sparse_ent.capacity() * sizeof(bucket_t) + _bucket_live.capacity() * sizeof(uint16_t),
+            .dense = _dense_ent.capacity() * sizeof(entity) + _ticks.capacity() * sizeof(uint32_t)
+        };
+    }
+
+    // change tracking, every dense slot remembers the tick it was last emplaced or touched in
+    // the owning registry moves the current tick forward once per frame
+    uint32_t tick() const noexcept {
+        return _tick;
+    }
+    void set_tick(uint32_t tick) noexcept {
+        _tick = tick;
+    }
+    // NOTE : ent has to be contained
+    void touch(entity ent) {
+        _ticks[index_of(ent)] = _tick;
+        if (!_on_update.empty()) {
+            _on_update.publish(*this, ent);
+        }
+    }
+    bool changed_since(entity ent, uint32_t since) const noexcept {
+        return tick_after(_ticks[index_of(ent)], since);
+    }
+    // parallel to data()
+    const uint32_t* ticks() const noexcept {
+        return _ticks.data();
+    }
+    // wraparound safe as long as the two are less than 2^31 ticks apart
+    static bool tick_after(uint32_t tick, uint32_t since) noexcept {
+        return static_cast<int32_t>(tick - since) > 0;
+    }
+
+    // the entities other holds move to the front in other's order, the rest keep theirs behind them
+    void sort_as(const entity_set& other) {
+        assert_sortable();
+        auto pos = 0u;
+        for (auto i = 0u; i < other.size(); ++i) {
+            const entity ent = other._dense_ent[i];
+            if (contains(ent)) {
+                swap_dense(index_of(ent), pos++);
+            }
+        }
+    }
+
+    // after ent and its component were added, before they are removed, after a patch
+    entity_signal& on_construct() noexcept {
+        return _on_construct;
+    }
+    entity_signal& on_destroy() noexcept {
+        return _on_destroy;
+    }
+    entity_signal& on_update() noexcept {
+        return _on_update;
+    }
+
+    // held by par_each, debug builds reject emplace and remove meanwhile
+    void lock_structure() noexcept {
+#ifdef DEBUG
+        _structure_locks.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+    void unlock_structure() noexcept {
+#ifdef DEBUG
+        _structure_locks.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    }
+
+    // swaps two dense positions, entities and components alike
+    void swap_dense(uint32_t lhs, uint32_t rhs) {
+        if (lhs == rhs) {
+            return;
+        }
+        const entity lhs_ent = _dense_ent[lhs];
+        const entity rhs_ent = _dense_ent[rhs];
+        std::swap(_dense_ent[lhs], _dense_ent[rhs]);
+        std::swap(_ticks[lhs], _ticks[rhs]);
+        _sparse_ent[bucket_index(lhs_ent)][bucket_offset(lhs_ent)] = rhs;
+        _sparse_ent[bucket_index(rhs_ent)][bucket_offset(rhs_ent)] = lhs;
+        swap_component(lhs, rhs);
+    }
+    // NOTE : ent has to be contained
+    uint32_t index_of(entity ent) const noexcept {
+        return _sparse_ent[bucket_index(ent)][bucket_offset(ent)];
     }
 
     uint32_t size() const {
         return static_cast<uint32_t>(_dense_ent.size());
     }
+    const entity* data() const noexcept {
+        return _dense_ent.data();
+    }
+    owning_group_data* group() const noexcept {
+        return _group;
+    }
+    void set_group(owning_group_data* group) noexcept {
+        _group = group;
+    }
+    std::pmr::memory_resource* resource() const noexcept {
+        return _dense_ent.get_allocator().resource();
+    }
 
     iterator begin() {
         return _dense_ent.rbegin();
@@ -56,39 +352,142 @@ public:
     }
 
 protected:
+    // takes ent out of the dense array, returns the position its component has to leave
+    uint32_t remove_dense(entity ent) {
+        assert_unlocked();
+        if (!_on_destroy.empty()) {
+            _on_destroy.publish(*this, ent);
+        }
+        if (_group != nullptr) {
+            _group->on_remove(ent);
+        }
+
+        // TODO : assume exists
+        const entity index = index_of(ent);
+        const entity back_ent = _dense_ent.back();
+
+        std::swap(_dense_ent[index], _dense_ent.back());
+        _dense_ent.pop_back();
+        std::swap(_ticks[index], _ticks.back());
+        _ticks.pop_back();
+
+        _sparse_ent[bucket_index(back_ent)][bucket_offset(back_ent)] = index;
+        release_entry(ent);
+        return index;
+    }
+
     virtual void remove_component(entity) = 0;
+    virtual void swap_component(uint32_t lhs, uint32_t rhs) = 0;
+    // removed is sorted, same dense positions remove_batch took out
+    virtual void erase_components(const std::vector<uint32_t>& removed) = 0;
+
+    template<typename Vec>
+    static void erase_sorted(Vec& vec, const std::vector<uint32_t>& removed) {
+        auto out = removed.front();
+        auto next = 0ull;
+        for (auto in = removed.front(); in < vec.size(); ++in) {
+            if (next < removed.size() && removed[next] == in) {
+                next += 1;
+                continue;
+            }
+            vec[out++] = std::move(vec[in]);
+        }
+        vec.erase(vec.begin() + out, vec.end());
+    }
 
-    static constexpr auto BUCKET_CAP = 1024u;
+    static constexpr auto BUCKET_CAP = sparse_page_pool::page_bytes;
     static constexpr auto BUCKET_ENTITY_CAP = BUCKET_CAP / sizeof(entity);
-    using bucket_t = std::unique_ptr<entity[]>;
+    using bucket_t = entity*;
 
     uint32_t bucket_index(entity ent) const noexcept {
-        return ent / BUCKET_ENTITY_CAP;
+        return entity_index(ent) / BUCKET_ENTITY_CAP;
     }
     uint32_t bucket_offset(entity ent) const noexcept {
-        return ent % BUCKET_ENTITY_CAP; // for pow of 2 can just bitwise and
+        return entity_index(ent) % BUCKET_ENTITY_CAP; // for pow of 2 can just bitwise and
     }
     bucket_t& secure_bucket(uint32_t index) {
         if (index >= _sparse_ent.size()) {
             _sparse_ent.resize(index + 1);
+            _bucket_live.resize(index + 1);
         }
 
         if (!_sparse_ent[index]) {
-            _sparse_ent[index].reset(new entity[BUCKET_ENTITY_CAP]);
-            std::fill(_sparse_ent[index].get(), _sparse_ent[index].get() + BUCKET_ENTITY_CAP, null_entity);
+            void* page = _pages != nullptr ? _pages->allocate() : resource()->allocate(BUCKET_CAP, alignof(entity));
+            _sparse_ent[index] = static_cast<entity*>(page);
+            std::fill(_sparse_ent[index], _sparse_ent[index] + BUCKET_ENTITY_CAP, null_entity);
         }
         return _sparse_ent[index];
     }
+    // clears ent's sparse entry, the page goes back once its last entity left
+    void release_entry(entity ent) noexcept {
+        const uint32_t bucket = bucket_index(ent);
+        _sparse_ent[bucket][bucket_offset(ent)] = null_entity;
+        if (--_bucket_live[bucket] == 0) {
+            release_page(_sparse_ent[bucket]);
+            _sparse_ent[bucket] = nullptr;
+        }
+    }
+    void release_page(bucket_t bucket) noexcept {
+        if (_pages != nullptr) {
+            _pages->deallocate(bucket);
+        } else {
+            resource()->deallocate(bucket, BUCKET_CAP, alignof(entity));
+        }
+    }
+
+    void assert_sortable() const {
+        assert_unlocked();
+        if (_group != nullptr) {
+            LOG_ERR("Sorting a set owned by a group would break the group, %u entities", size());
+            dbg::panic();
+        }
+    }
+    // dense position i takes what was at order[i], order is left as identity
+    void permute(std::vector<uint32_t>& order) {
+        for (auto i = 0u; i < order.size(); ++i) {
+            auto curr = i;
+            while (order[curr] != i) {
+                const auto next = order[curr];
+                swap_dense(curr, next);
+                order[curr] = curr;
+                curr = next;
+            }
+            order[curr] = curr;
+        }
+    }
 
-    std::vector<bucket_t> _sparse_ent;
-    std::vector<entity> _dense_ent;
+    void assert_unlocked() const noexcept {
+#ifdef DEBUG
+        assert(_structure_locks.load(std::memory_order_relaxed) == 0 && "structural change during par_each");
+#endif
+    }
+
+    std::pmr::vector<bucket_t> _sparse_ent;
+    // entities per sparse page, at most BUCKET_ENTITY_CAP
+    std::pmr::vector<uint16_t> _bucket_live;
+    std::pmr::vector<entity> _dense_ent;
+    std::pmr::vector<uint32_t> _ticks;
+    uint32_t _tick = 0;
+    owning_group_data* _group = nullptr;
+    sparse_page_pool* _pages;
+    entity_signal _on_construct;
+    entity_signal _on_destroy;
+    entity_signal _on_update;
+#ifdef DEBUG
+    std::atomic<uint32_t> _structure_locks{ 0 };
+#endif
 };
 
 template<typename Component>
-class component_set : public entity_set {
+class component_set final : public entity_set {
 public:
-    using iterator = typename std::vector<Component>::reverse_iterator;
-    using const_iterator = typename std::vector<Component>::const_reverse_iterator;
+    using iterator = typename std::pmr::vector<Component>::reverse_iterator;
+    using const_iterator = typename std::pmr::vector<Component>::const_reverse_iterator;
+
+    explicit component_set(std::pmr::memory_resource* resource = std::pmr::get_default_resource(), sparse_page_pool* pages = nullptr) :
+        entity_set{ resource, pages },
+        _components{ resource }
+    {}
 
     template<typename... Args>
     void emplace(entity ent, Args&&... args) {
@@ -101,12 +500,89 @@ public:
 
         entity_set::emplace(ent);
     }
+    // same value for every entity
+    void insert(const entity* ents, uint32_t count, const Component& value) {
+        reserve(size() + count);
+        _components.insert(_components.end(), count, value);
+        entity_set::emplace_range(ents, count);
+    }
+    // one component per entity read from first
+    // NOTE : a plain copy for pointers to trivially copyable components
+    template<typename It>
+    void insert(const entity* ents, uint32_t count, It first) {
+        reserve(size() + count);
+        _components.insert(_components.end(), first, std::next(first, count));
+        entity_set::emplace_range(ents, count);
+    }
+    // hides entity_set::remove, no virtual call when the component type is known
+    void remove(entity ent) {
+        remove_component(remove_dense(ent));
+    }
+    void reserve(uint32_t count) override {
+        entity_set::reserve(count);
+        _components.reserve(count);
+    }
+    pool_memory memory_usage() const noexcept override {
+        pool_memory ret = entity_set::memory_usage();
+        ret.components = _components.capacity() * sizeof(Component);
+        return ret;
+    }
+
+    Component* data() noexcept {
+        return _components.data();
+    }
+    const Component* data() const noexcept {
+        return _components.data();
+    }
     Component& get(entity ent) {
         return _components[_sparse_ent[bucket_index(ent)][bucket_offset(ent)]];
     }
     const Component& get(entity ent) const {
         return _components[_sparse_ent[bucket_index(ent)][bucket_offset(ent)]];
     }
+    // mutable access that marks the component changed in the current tick
+    // NOTE : on_update listeners run before the caller writes, patch(ent, fun) runs them after fun
+    Component& patch(entity ent) {
+        touch(ent);
+        return get(ent);
+    }
+    template<typename Fun>
+    void patch(entity ent, Fun fun) {
+        fun(get(ent));
+        touch(ent);
+    }
+
+    // reorders data() and the dense entities together, eg by draw key or morton code
+    // comp is less(const Component&, const Component&), less(entity, entity)
+    // or a key(const Component&) projection computed once per component
+    // NOTE : data() order, the range for over a view walks it back to front
+    template<typename Compare>
+    void sort(Compare comp) {
+        assert_sortable();
+        std::vector<uint32_t> order(size());
+        std::iota(order.begin(), order.end(), 0u);
+
+        if constexpr (std::is_invocable_v<Compare, const Component&>) {
+            using key_type = std::decay_t<std::invoke_result_t<Compare, const Component&>>;
+            std::vector<key_type> keys;
+            keys.reserve(size());
+            for (const auto& component : _components) {
+                keys.push_back(comp(component));
+            }
+            std::stable_sort(order.begin(), order.end(), [&keys](uint32_t l, uint32_t r) {
+                return keys[l] < keys[r];
+            });
+        } else if constexpr (std::is_invocable_r_v<bool, Compare, const Component&, const Component&>) {
+            std::stable_sort(order.begin(), order.end(), [this, &comp](uint32_t l, uint32_t r) {
+                return comp(_components[l], _components[r]);
+            });
+        } else {
+            std::stable_sort(order.begin(), order.end(), [this, &comp](uint32_t l, uint32_t r) {
+                return comp(_dense_ent[l], _dense_ent[r]);
+            });
+        }
+        permute(order);
+    }
 
     iterator begin() {
         return _components.rbegin();
@@ -126,7 +602,80 @@ private:
         std::swap(_components[index], _components.back());
         _components.pop_back();
     }
+    void swap_component(uint32_t lhs, uint32_t rhs) override {
+        std::swap(_components[lhs], _components[rhs]);
+    }
+    void erase_components(const std::vector<uint32_t>& removed) override {
+        erase_sorted(_components, removed);
+    }
 
-    std::vector<Component> _components;
+    std::pmr::vector<Component> _components;
 };
-}
\ No newline at end of file
+
+
+
+#ifdef DRY_ECS_AVX2
+inline uint32_t entity_set::contains_batch(const entity* ents) const noexcept {
+    static_assert(BUCKET_ENTITY_CAP == 256, "bucket shift below assumes 256 entities per bucket");
+    const __m256i ent_v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ents));
+    const __m256i index = _mm256_and_si256(ent_v, _mm256_set1_epi32(entity_index_mask));
+    const __m256i bucket = _mm256_srli_epi32(index, 8);
+    const __m256i offset = _mm256_and_si256(index, _mm256_set1_epi32(BUCKET_ENTITY_CAP - 1));
+    const __m256i in_range = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(_sparse_ent.size())), bucket);
+
+    // page pointers, then the sparse entries behind them as absolute addresses, 4 lanes at a time
+    const auto sparse_half = [this](__m128i bucket, __m128i offset, __m128i in_range) {
+        const auto* pages = reinterpret_cast<const long long*>(_sparse_ent.data());
+        const __m256i page = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), pages, bucket, _mm256_cvtepi32_epi64(in_range), 8);
+        const __m256i addr = _mm256_add_epi64(page, _mm256_slli_epi64(_mm256_cvtepu32_epi64(offset), 2));
+        const __m256i null_page = _mm256_cmpeq_epi64(page, _mm256_setzero_si256());
+        // 64 bit lane mask down to 32 bit lanes
+        const __m128i valid = _mm_xor_si128(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(null_page, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6))), _mm_set1_epi32(-1));
+        return _mm256_mask_i64gather_epi32(_mm_set1_epi32(-1), static_cast<const int*>(nullptr), addr, valid, 1);
+    };
+    const __m128i sparse_lo = sparse_half(_mm256_castsi256_si128(bucket), _mm256_castsi256_si128(offset), _mm256_castsi256_si128(in_range));
+    const __m128i sparse_hi = sparse_half(_mm256_extracti128_si256(bucket, 1), _mm256_extracti128_si256(offset, 1), _mm256_extracti128_si256(in_range, 1));
+    const __m256i sparse = _mm256_set_m128i(sparse_hi, sparse_lo);
+
+    // NOTE : null_entity is all ones, dense positions stay below 2^20 and gather as positive
+    const __m256i valid = _mm256_xor_si256(_mm256_cmpeq_epi32(sparse, _mm256_set1_epi32(-1)), _mm256_set1_epi32(-1));
+    const __m256i dense = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(_dense_ent.data()), sparse, valid, 4);
+    const __m256i hit = _mm256_and_si256(valid, _mm256_cmpeq_epi32(dense, ent_v));
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+}
+#else
+inline uint32_t entity_set::contains_batch(const entity* ents) const noexcept {
+    // NOTE : no gathers before avx2, a branch free scalar version (null bucket sentinel, masked
+    // dense read) measured 1.5-2x slower than this and than one entity at a time in each_range
+    uint32_t ret = 0;
+    for (auto i = 0u; i < batch_width; ++i) {
+        ret |= uint32_t{ contains(ents[i]) } << i;
+    }
+    return ret;
+}
+#endif
+
+inline void owning_group_data::on_emplace(entity ent) {
+    for (const auto* set : owned) {
+        if (!set->contains(ent)) {
+            return;
+        }
+    }
+    for (auto* set : owned) {
+        set->swap_dense(set->index_of(ent), size);
+    }
+    size += 1;
+}
+
+inline void owning_group_data::on_remove(entity ent) {
+    // in the group only if inside the prefix of the set being removed from, all share it
+    if (size == 0 || !owned.front()->contains(ent) || owned.front()->index_of(ent) >= size) {
+        return;
+    }
+    size -= 1;
+    for (auto* set : owned) {
+        set->swap_dense(set->index_of(ent), size);
+    }
+}
+
+}
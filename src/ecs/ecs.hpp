@@ -1,57 +1,287 @@
 #pragma once
 
-#include <any>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
 
-#include "util/persistent_array.hpp"
 #include "util/type.hpp"
+#include "dbg/log.hpp"
 
+#include "entity.hpp"
+#include "component_mask.hpp"
 #include "pool_view.hpp"
 
 namespace dry::ecs {
 
+class command_buffer;
+class snapshot;
+
 class ec_registry {
     template<typename T>
     using component_type_id = util::type_id<T, ec_registry>;
     using pool_base = std::unique_ptr<entity_set>;
 
 public:
+    explicit ec_registry(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _resource{ resource },
+        _entities{ resource },
+        _masks{ resource },
+        _pages{ resource }
+    {}
+
     entity create() {
-        return _entities.emplace(null_entity);
+        const entity ent = _entities.create();
+        if (entity_index(ent) >= _masks.size()) {
+            _masks.resize(entity_index(ent) + 1);
+        }
+        return ent;
+    }
+    void create_n(entity* out, uint32_t count) {
+        _entities.create_n(out, count);
+        if (_entities.capacity() > _masks.size()) {
+            _masks.resize(_entities.capacity());
+        }
     }
+    // only visits the pools the entity is in
+    // skipped when ent is no longer valid, its index may already belong to another entity
     void destroy(entity ent) {
-        for (auto& pool : _component_pools) {
-            if (pool->contains(ent)) {
-                pool->remove(ent);
+        if (!_entities.valid(ent)) {
+            return;
+        }
+        auto& mask = _masks[entity_index(ent)];
+        mask.for_each([this, ent](uint32_t component_id) {
+            _component_pools[component_id]->remove(ent);
+        });
+        mask.clear();
+        _entities.destroy(ent);
+    }
+    // every pool gets one removal list and compacts once, invalid or repeated entities are skipped
+    void destroy_range(const entity* ents, uint32_t count) {
+        std::vector<std::vector<entity>> removed(_component_pools.size());
+        for (auto i = 0u; i < count; ++i) {
+            const entity ent = ents[i];
+            if (!_entities.valid(ent)) {
+                continue;
+            }
+            auto& mask = _masks[entity_index(ent)];
+            mask.for_each([&removed, ent](uint32_t component_id) {
+                removed[component_id].push_back(ent);
+            });
+            mask.clear();
+            _entities.destroy(ent);
+        }
+        for (auto id = 0u; id < removed.size(); ++id) {
+            if (!removed[id].empty()) {
+                _component_pools[id]->remove_batch(removed[id].data(), static_cast<uint32_t>(removed[id].size()));
             }
         }
-        _entities.remove(ent);
     }
+    // thread safe, the entity is only valid once the command_buffer it came from is applied
+    entity reserve() noexcept {
+        return _entities.reserve();
+    }
+    bool valid(entity ent) const noexcept {
+        return _entities.valid(ent);
+    }
+    uint32_t alive() const noexcept {
+        return _entities.alive();
+    }
+
     template<typename Component, typename... Args>
     void attach(entity ent, Args&&... args) {
+        assure<Component>().emplace(ent, std::forward<Args>(args)...);
+        _masks[entity_index(ent)].set(component_type_id<Component>::value());
+    }
+    // NOTE : none of ents may have the component yet
+    template<typename Component>
+    void attach_range(const entity* ents, uint32_t count, const Component& value) {
+        assure<Component>().insert(ents, count, value);
+        set_mask_bits(ents, count, component_type_id<Component>::value());
+    }
+    template<typename Component, typename It>
+    void attach_range(const entity* ents, uint32_t count, It first) {
+        assure<Component>().insert(ents, count, first);
+        set_mask_bits(ents, count, component_type_id<Component>::value());
+    }
+    template<typename Component>
+    void detach(entity ent) {
         const auto component_id = component_type_id<Component>::value();
+        _component_pools[component_id]->remove(ent);
+        _masks[entity_index(ent)].reset(component_id);
+    }
+    template<typename Component>
+    bool has(entity ent) const noexcept {
+        return _masks[entity_index(ent)].test(component_type_id<Component>::value());
+    }
+    // the component, marked changed in the current tick
+    template<typename Component>
+    Component& patch(entity ent) {
+        return assure<Component>().patch(ent);
+    }
+    template<typename Component, typename Fun>
+    void patch(entity ent, Fun fun) {
+        assure<Component>().patch(ent, std::move(fun));
+    }
 
-        if (component_id >= _component_pools.size()) {
-            _component_pools.resize(component_id + 1);
-            _component_pools[component_id] = std::make_unique<component_set<Component>>();
+    // emplace and patch stamp components with the current tick, call once per frame
+    // view::each_changed(since) then sees what changed after the tick since was current
+    uint32_t tick() const noexcept {
+        return _tick;
+    }
+    void advance_tick() noexcept {
+        _tick += 1;
+        for (auto& pool : _component_pools) {
+            if (pool) {
+                pool->set_tick(_tick);
+            }
         }
+    }
 
-        auto& pool = *static_cast<component_set<Component>*>(_component_pools[component_id].get());
-        pool.emplace(ent, std::forward<Args>(args)...);
+    // listeners get the component's set and the entity, see entity_signal
+    template<typename Component>
+    entity_signal& on_construct() {
+        return assure<Component>().on_construct();
     }
     template<typename Component>
-    void detach(entity ent) {
-        const auto component_id = component_type_id<Component>::value();
-        _component_pools[component_id]->remove(ent);
+    entity_signal& on_destroy() {
+        return assure<Component>().on_destroy();
+    }
+    template<typename Component>
+    entity_signal& on_update() {
+        return assure<Component>().on_update();
+    }
+
+    template<typename Component>
+    pool_memory memory_usage() {
+        return assure<Component>().memory_usage();
+    }
+    // every pool plus the entity bookkeeping, sparse counts what the page pool reserved
+    pool_memory memory_usage() const noexcept {
+        pool_memory ret;
+        for (const auto& pool : _component_pools) {
+            if (pool) {
+                const pool_memory usage = pool->memory_usage();
+                ret.dense += usage.dense;
+                ret.components += usage.components;
+                ret.sparse += usage.sparse - uint64_t{ pool->sparse_pages() } * sparse_page_pool::page_bytes;
+            }
+        }
+        ret.sparse += _pages.reserved_bytes();
+        ret.dense += _masks.capacity() * sizeof(component_mask) + _entities.capacity() * sizeof(entity);
+        return ret;
+    }
+
+    // see component_set::sort, NOTE : not for components owned by a group
+    template<typename Component, typename Compare>
+    void sort(Compare comp) {
+        assure<Component>().sort(std::move(comp));
+    }
+    // To's shared entities in From's order, eg after sorting From by draw key
+    template<typename To, typename From>
+    void sort_as() {
+        assure<To>().sort_as(assure<From>());
+    }
+
+    // the component's set, created on first use, eg to walk data() as a column
+    template<typename Component>
+    component_set<Component>& pool() {
+        return assure<Component>();
     }
 
     template<typename... View_Comp>
     component_view<View_Comp...> view() {
-        return { static_cast<component_set<View_Comp>*>(_component_pools[component_type_id<View_Comp>::value()].get())... };
+        return { &assure<View_Comp>()... };
+    }
+
+    // owning group, the first call sorts the shared entities into the prefix,
+    // after that component_set emplace/remove keep it valid
+    // NOTE : a set can only be owned by one group
+    template<typename... Owned>
+    component_group<Owned...> group() {
+        static_assert(sizeof...(Owned) > 1, "A group needs at least two owned components");
+
+        entity_set* sets[] = { &assure<Owned>()... };
+        owning_group_data* data = sets[0]->group();
+        if (data == nullptr) {
+            for (auto i = 0u; i < sizeof...(Owned); ++i) {
+                if (sets[i]->group() != nullptr) {
+                    LOG_ERR("Owned component %u of the group is already owned by another group", i);
+                    dbg::panic();
+                }
+            }
+            data = _groups.emplace_back(std::make_unique<owning_group_data>()).get();
+            data->owned.assign(std::begin(sets), std::end(sets));
+
+            entity_set* smallest = *std::min_element(std::begin(sets), std::end(sets), [](auto* l, auto* r) {
+                return l->size() < r->size();
+            });
+            // copy, the swaps reorder the dense array under us
+            const std::vector<entity> candidates(smallest->data(), smallest->data() + smallest->size());
+            for (const auto ent : candidates) {
+                data->on_emplace(ent);
+            }
+            for (auto* set : sets) {
+                set->set_group(data);
+            }
+        } else {
+            // only the exact owned list shares the prefix, any order of it
+            bool same = data->owned.size() == sizeof...(Owned);
+            for (auto* set : sets) {
+                same = same && set->group() == data;
+            }
+            if (!same) {
+                LOG_ERR("Group of %u components requested over sets owned by a group of %u", static_cast<uint32_t>(sizeof...(Owned)),
+                    static_cast<uint32_t>(data->owned.size()));
+                dbg::panic();
+            }
+        }
+        return { data, &assure<Owned>()... };
     }
 
 private:
-    persistent_array<entity> _entities;
+    friend class command_buffer;
+    friend class snapshot;
+
+    void set_mask_bits(const entity* ents, uint32_t count, uint32_t component_id) noexcept {
+        for (auto i = 0u; i < count; ++i) {
+            _masks[entity_index(ents[i])].set(component_id);
+        }
+    }
+
+    void flush_reserved() {
+        _entities.flush_reserved();
+        if (_entities.capacity() > _masks.size()) {
+            _masks.resize(_entities.capacity());
+        }
+    }
+
+    template<typename Component>
+    component_set<Component>& assure() {
+        const auto component_id = component_type_id<Component>::value();
+        if (component_id >= component_mask::max_components) {
+            LOG_ERR("Too many component types, component_mask holds %u", component_mask::max_components);
+            dbg::panic();
+        }
+
+        if (component_id >= _component_pools.size()) {
+            _component_pools.resize(component_id + 1);
+        }
+        if (!_component_pools[component_id]) {
+            _component_pools[component_id] = std::make_unique<component_set<Component>>(_resource, &_pages);
+            _component_pools[component_id]->set_tick(_tick);
+        }
+        return *static_cast<component_set<Component>*>(_component_pools[component_id].get());
+    }
+
+    std::pmr::memory_resource* _resource;
+    entity_allocator _entities;
+    std::pmr::vector<component_mask> _masks;
+    // before the pools, they hand their pages back on destruction
+    sparse_page_pool _pages;
     std::vector<pool_base> _component_pools;
+    std::vector<std::unique_ptr<owning_group_data>> _groups;
+    uint32_t _tick = 0;
 };
 
-}
\ No newline at end of file
+}
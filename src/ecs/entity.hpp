@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <memory_resource>
+
+#include "dbg/log.hpp"
+
+namespace dry::ecs {
+
+// low bits index the sparse sets, high bits count how many times the index was recycled
+using entity = uint32_t;
+constexpr entity null_entity = std::numeric_limits<entity>::max();
+
+constexpr uint32_t entity_index_bits = 20;
+constexpr uint32_t entity_version_bits = 32 - entity_index_bits;
+constexpr uint32_t entity_index_mask = (1u << entity_index_bits) - 1;
+constexpr uint32_t entity_version_mask = (1u << entity_version_bits) - 1;
+// NOTE : the all ones index is reserved for null_entity
+constexpr uint32_t max_entity_count = entity_index_mask;
+
+constexpr uint32_t entity_index(entity ent) noexcept {
+    return ent & entity_index_mask;
+}
+constexpr uint32_t entity_version(entity ent) noexcept {
+    return ent >> entity_index_bits;
+}
+constexpr entity make_entity(uint32_t index, uint32_t version) noexcept {
+    return (version & entity_version_mask) << entity_index_bits | (index & entity_index_mask);
+}
+
+// hands out entities, destroyed indices are reused with a bumped version
+// so stale handles stop comparing equal to the live one
+class entity_allocator {
+public:
+    explicit entity_allocator(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _entities{ resource }
+    {}
+
+    entity create() {
+        if (_available != entity_index_mask) {
+            // free slots store the next free index where the live one keeps its own
+            const uint32_t index = _available;
+            _available = entity_index(_entities[index]);
+            _entities[index] = make_entity(index, entity_version(_entities[index]));
+            _alive += 1;
+            return _entities[index];
+        }
+
+        const uint32_t index = claim_fresh(1);
+        flush_reserved();
+        return _entities[index];
+    }
+    // free slots first, the rest as one contiguous block of fresh indices
+    void create_n(entity* out, uint32_t count) {
+        auto i = 0u;
+        for (; i < count && _available != entity_index_mask; ++i) {
+            out[i] = create();
+        }
+        if (i == count) {
+            return;
+        }
+        const uint32_t first = claim_fresh(count - i);
+        _entities.reserve(first + (count - i));
+        flush_reserved();
+        for (auto index = first; i < count; ++i, ++index) {
+            out[i] = _entities[index];
+        }
+    }
+    // thread safe, always a fresh index, the entity becomes valid with the next flush_reserved
+    entity reserve() noexcept {
+        return make_entity(claim_fresh(1), 0);
+    }
+    // makes every reserved entity valid, not thread safe
+    void flush_reserved() {
+        const uint32_t end = _reserved_end.load(std::memory_order_relaxed);
+        while (_entities.size() < end) {
+            _entities.push_back(make_entity(static_cast<uint32_t>(_entities.size()), 0));
+            _alive += 1;
+        }
+    }
+    // a stale or repeated handle is ignored, it would push its index on the free list twice
+    void destroy(entity ent) {
+        if (!valid(ent)) {
+            return;
+        }
+        const uint32_t index = entity_index(ent);
+        _entities[index] = make_entity(_available, entity_version(ent) + 1);
+        _available = index;
+        _alive -= 1;
+    }
+
+    bool valid(entity ent) const noexcept {
+        const uint32_t index = entity_index(ent);
+        return index < _entities.size() && _entities[index] == ent;
+    }
+    uint32_t alive() const noexcept {
+        return _alive;
+    }
+    // one past the highest index handed out so far
+    uint32_t capacity() const noexcept {
+        return static_cast<uint32_t>(_entities.size());
+    }
+
+    // raw state for snapshots, free slots hold the next free index instead of their own
+    const entity* slots() const noexcept {
+        return _entities.data();
+    }
+    uint32_t free_head() const noexcept {
+        return _available;
+    }
+    void restore(const entity* slots, uint32_t count, uint32_t free_head, uint32_t alive) {
+        _entities.assign(slots, slots + count);
+        _reserved_end.store(count, std::memory_order_relaxed);
+        _available = free_head;
+        _alive = alive;
+    }
+
+private:
+    // first of count fresh indices, make_entity would wrap anything past max_entity_count onto index 0
+    uint32_t claim_fresh(uint32_t count) noexcept {
+        const uint32_t first = _reserved_end.fetch_add(count, std::memory_order_relaxed);
+        if (count > max_entity_count - (std::min)(first, max_entity_count)) {
+            LOG_ERR("Entity limit of %u exceeded, %u more requested at %u", max_entity_count, count, first);
+            dbg::panic();
+        }
+        return first;
+    }
+
+    std::pmr::vector<entity> _entities;
+    std::atomic<uint32_t> _reserved_end{ 0 };
+    uint32_t _available = entity_index_mask;
+    uint32_t _alive = 0;
+};
+
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <bit>
 #include <tuple>
+#include <algorithm>
+#include <type_traits>
+
+#include "util/thread_pool.hpp"
 
 #include "component_set.hpp"
 
@@ -85,6 +90,47 @@ public:
         }
     }
 
+    // fun(Component&...) or fun(entity, Component&...) in the main pool's dense order
+    // membership is tested entity_set::batch_width candidates at a time against every other pool
+    template<typename Fun>
+    void each(Fun fun) {
+        each_range(0, _main_pool->size(), fun);
+    }
+
+    // each() from several threads
+    // the main pool's dense range is split in chunks, each covers the same entities every call
+    // NOTE : no emplace or remove on the viewed pools until it returns, asserted in debug
+    template<typename Fun>
+    void par_each(Fun fun, u64_t min_chunk = default_min_chunk, thread_pool& pool = thread_pool::global()) {
+        (std::get<component_set<Component>*>(_pools)->lock_structure(), ...);
+
+        pool.parallel_for(_main_pool->size(), min_chunk, [this, &fun](u64_t beg, u64_t end) {
+            each_range(static_cast<uint32_t>(beg), static_cast<uint32_t>(end), fun);
+        });
+
+        (std::get<component_set<Component>*>(_pools)->unlock_structure(), ...);
+    }
+
+    // fun(Component&...) or fun(entity, Component&...) for the entities whose Changed component
+    // was emplaced or patched after tick since, walks Changed's dense array instead of the main pool
+    template<typename Changed, typename Fun>
+    void each_changed(uint32_t since, Fun fun) {
+        auto* changed = std::get<component_set<Changed>*>(_pools);
+        const entity* ents = changed->entity_set::data();
+        const uint32_t* ticks = changed->ticks();
+        for (auto i = changed->size(); i-- > 0;) {
+            const entity ent = ents[i];
+            if (!entity_set::tick_after(ticks[i], since) || !(std::get<component_set<Component>*>(_pools)->contains(ent) && ...)) {
+                continue;
+            }
+            if constexpr (std::is_invocable_v<Fun, entity, Component&...>) {
+                fun(ent, std::get<component_set<Component>*>(_pools)->get(ent)...);
+            } else {
+                fun(std::get<component_set<Component>*>(_pools)->get(ent)...);
+            }
+        }
+    }
+
     view_iterator begin() {
         return { _main_pool->begin(), _main_pool->end(), &_pools };
     }
@@ -92,9 +138,137 @@ public:
         return { _main_pool->end(), _main_pool->end(), &_pools };
     }
 
+    static constexpr u64_t default_min_chunk = 1024;
+
 private:
+    template<typename Fun>
+    void each_range(uint32_t beg, uint32_t end, Fun& fun) {
+        constexpr uint32_t width = entity_set::batch_width;
+        const entity* ents = _main_pool->data();
+
+        // one entity at a time stops at its first missing pool, cheaper unless the batch is
+        // native and the pools stay cache resident, past that the gathers miss on every lane
+        const bool batched = entity_set::batch_native && _main_pool->size() <= batch_max_size;
+        for (; batched && beg + width <= end; beg += width) {
+            // stops at the first pool that leaves nothing of the batch
+            uint32_t match = (1u << width) - 1;
+            static_cast<void>((narrow_batch(std::get<component_set<Component>*>(_pools), ents + beg, match) && ...));
+            for (; match != 0; match &= match - 1) {
+                invoke(fun, ents[beg + std::countr_zero(match)]);
+            }
+        }
+        for (; beg < end; ++beg) {
+            if ((std::get<component_set<Component>*>(_pools)->contains(ents[beg]) && ...)) {
+                invoke(fun, ents[beg]);
+            }
+        }
+    }
+    // view_overlap crossed over between 50k and 150k main pool entities
+    static constexpr uint32_t batch_max_size = 1u << 16;
+    // once few lanes survive, testing just those beats a whole batch against one more pool
+    static constexpr int sparse_batch_lanes = 2;
+    bool narrow_batch(const entity_set* set, const entity* ents, uint32_t& match) const noexcept {
+        if (set == _main_pool) {
+            return true;
+        }
+        if (std::popcount(match) <= sparse_batch_lanes) {
+            for (auto lanes = match; lanes != 0; lanes &= lanes - 1) {
+                const auto lane = std::countr_zero(lanes);
+                match &= set->contains(ents[lane]) ? ~0u : ~(1u << lane);
+            }
+        } else {
+            match &= set->contains_batch(ents);
+        }
+        return match != 0;
+    }
+    template<typename Fun>
+    void invoke(Fun& fun, entity ent) {
+        if constexpr (std::is_invocable_v<Fun, entity, Component&...>) {
+            fun(ent, std::get<component_set<Component>*>(_pools)->get(ent)...);
+        } else {
+            fun(std::get<component_set<Component>*>(_pools)->get(ent)...);
+        }
+    }
+
     pool_tuple _pools;
     entity_set* _main_pool;
 };
 
-}
\ No newline at end of file
+// entities in all owned sets sit in the same dense prefix of each,
+// iteration walks the arrays in lockstep without membership checks
+template<typename... Owned>
+class component_group {
+public:
+    using pool_tuple = std::tuple<component_set<Owned>*...>;
+
+    component_group(owning_group_data* data, component_set<Owned>*... components) :
+        _pools(components...),
+        _data(data)
+    {}
+
+    uint32_t size() const noexcept {
+        return _data->size;
+    }
+    // the group members, same order as the owned component arrays
+    const entity* entities() const noexcept {
+        return std::get<0>(_pools)->entity_set::data();
+    }
+    template<typename Comp>
+    Comp* data() noexcept {
+        return std::get<component_set<Comp>*>(_pools)->data();
+    }
+
+    template<typename... Get_Comp>
+    decltype(auto) get(entity ent) {
+        if constexpr (sizeof...(Get_Comp) == 1) {
+            return (std::get<component_set<Get_Comp>*>(_pools)->get(ent), ...);
+        } else {
+            return std::forward_as_tuple(std::get<component_set<Get_Comp>*>(_pools)->get(ent)...);
+        }
+    }
+
+    // fun(Owned&...) or fun(entity, Owned&...)
+    // NOTE : no structural changes to the owned sets from inside fun
+    template<typename Fun>
+    void each(Fun fun) {
+        const uint32_t count = _data->size;
+        const entity* ents = entities();
+        auto arrays = std::make_tuple(std::get<component_set<Owned>*>(_pools)->data()...);
+        for (auto i = 0u; i < count; ++i) {
+            if constexpr (std::is_invocable_v<Fun, entity, Owned&...>) {
+                fun(ents[i], std::get<Owned*>(arrays)[i]...);
+            } else {
+                fun(std::get<Owned*>(arrays)[i]...);
+            }
+        }
+    }
+
+    // each() split over the thread pool, chunks of the prefix are deterministic
+    // NOTE : no emplace or remove on the owned pools until it returns, asserted in debug
+    template<typename Fun>
+    void par_each(Fun fun, u64_t min_chunk = default_min_chunk, thread_pool& pool = thread_pool::global()) {
+        (std::get<component_set<Owned>*>(_pools)->lock_structure(), ...);
+
+        const entity* ents = entities();
+        auto arrays = std::make_tuple(std::get<component_set<Owned>*>(_pools)->data()...);
+        pool.parallel_for(_data->size, min_chunk, [ents, &arrays, &fun](u64_t beg, u64_t end) {
+            for (; beg < end; ++beg) {
+                if constexpr (std::is_invocable_v<Fun, entity, Owned&...>) {
+                    fun(ents[beg], std::get<Owned*>(arrays)[beg]...);
+                } else {
+                    fun(std::get<Owned*>(arrays)[beg]...);
+                }
+            }
+        });
+
+        (std::get<component_set<Owned>*>(_pools)->unlock_structure(), ...);
+    }
+
+    static constexpr u64_t default_min_chunk = 1024;
+
+private:
+    pool_tuple _pools;
+    owning_group_data* _data;
+};
+
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/num.hpp"
+#include "util/type.hpp"
+#include "util/thread_pool.hpp"
+#include "dbg/log.hpp"
+
+#include "component_mask.hpp"
+
+namespace dry::ecs {
+
+template<typename... Component>
+struct reads {};
+template<typename... Component>
+struct writes {};
+
+// systems declare the components they read and write, run() executes a frame of them
+// in parallel where the sets don't conflict, keeping registration order where they do
+class scheduler {
+    template<typename T>
+    using component_type_id = util::type_id<T, scheduler>;
+
+public:
+    using system_id = u32_t;
+
+    struct system_stats {
+        // relative to the start of run()
+        f64_t start_ns = 0;
+        f64_t duration_ns = 0;
+    };
+
+    template<typename Reads, typename Writes, typename Fun>
+    system_id add(std::string name, Fun&& fun);
+    void set_enabled(system_id system, bool enabled);
+
+    // one frame, returns once every enabled system ran
+    // every ready system is a pool task of its own, finishing one spawns the successors it released
+    // so no worker sits blocked and par_each inside a system finds idle ones to help
+    void run(thread_pool& pool = thread_pool::global());
+
+    u32_t size() const noexcept { return static_cast<u32_t>(_systems.size()); }
+    const std::string& name(system_id system) const noexcept { return _systems[system].name; }
+    const system_stats& stats(system_id system) const noexcept { return _systems[system].stats; }
+    // longest chain of dependent systems last frame, what more threads can't shorten
+    f64_t critical_path_ns() const noexcept { return _critical_path_ns; }
+    f64_t frame_ns() const noexcept { return _frame_ns; }
+
+private:
+    struct system {
+        std::string name;
+        std::function<void()> fun;
+        component_mask read;
+        component_mask write;
+        bool enabled = true;
+
+        // rebuilt with the graph
+        std::vector<system_id> successors;
+        u32_t predecessor_count = 0;
+        system_stats stats;
+    };
+
+    template<typename... Component>
+    static component_mask mask_of(reads<Component...>) { return make_mask<Component...>(); }
+    template<typename... Component>
+    static component_mask mask_of(writes<Component...>) { return make_mask<Component...>(); }
+    template<typename... Component>
+    static component_mask make_mask();
+
+    static bool intersects(const component_mask& l, const component_mask& r) noexcept;
+    static bool conflicts(const system& l, const system& r) noexcept;
+
+    // state of one run(), shared by its system tasks
+    struct frame_ctx {
+        scheduler* self;
+        thread_pool* pool;
+        std::unique_ptr<std::atomic<u32_t>[]> waiting;
+        std::atomic<u64_t> pending{ 0 };
+        std::chrono::steady_clock::time_point t0;
+    };
+    static void run_system(void* ctx, u64_t id, u64_t);
+
+    // i -> j for i < j whenever they conflict, enabled systems only
+    void build_graph();
+    void update_critical_path();
+
+    std::vector<system> _systems;
+    u32_t _enabled_count = 0;
+    bool _graph_dirty = true;
+    f64_t _critical_path_ns = 0;
+    f64_t _frame_ns = 0;
+};
+
+
+
+// impl
+template<typename Reads, typename Writes, typename Fun>
+scheduler::system_id scheduler::add(std::string name, Fun&& fun) {
+    _systems.push_back({
+        .name = std::move(name),
+        .fun = std::forward<Fun>(fun),
+        .read = mask_of(Reads{}),
+        .write = mask_of(Writes{})
+    });
+    _graph_dirty = true;
+    return static_cast<system_id>(_systems.size() - 1);
+}
+
+inline void scheduler::set_enabled(system_id system, bool enabled) {
+    if (_systems[system].enabled != enabled) {
+        _systems[system].enabled = enabled;
+        _graph_dirty = true;
+    }
+}
+
+inline void scheduler::run(thread_pool& pool) {
+    using clock = std::chrono::steady_clock;
+
+    if (_graph_dirty) {
+        build_graph();
+        _graph_dirty = false;
+    }
+
+    if (_enabled_count == 0) {
+        _frame_ns = 0;
+        _critical_path_ns = 0;
+        return;
+    }
+
+    frame_ctx frame{ .self = this, .pool = &pool, .waiting = std::make_unique<std::atomic<u32_t>[]>(_systems.size()) };
+    for (auto i = 0u; i < _systems.size(); ++i) {
+        frame.waiting[i].store(_systems[i].predecessor_count, std::memory_order_relaxed);
+    }
+    frame.t0 = clock::now();
+
+    for (auto i = 0u; i < _systems.size(); ++i) {
+        if (_systems[i].enabled && _systems[i].predecessor_count == 0) {
+            pool.spawn(&run_system, &frame, i, i + 1, frame.pending);
+        }
+    }
+    pool.wait(frame.pending);
+
+    _frame_ns = std::chrono::duration<f64_t, std::nano>(clock::now() - frame.t0).count();
+    update_critical_path();
+}
+
+inline void scheduler::run_system(void* ctx, u64_t id, u64_t) {
+    using clock = std::chrono::steady_clock;
+    auto& frame = *static_cast<frame_ctx*>(ctx);
+    auto& sys = frame.self->_systems[id];
+
+    const auto beg = clock::now();
+    sys.fun();
+    const auto end = clock::now();
+    sys.stats.start_ns = std::chrono::duration<f64_t, std::nano>(beg - frame.t0).count();
+    sys.stats.duration_ns = std::chrono::duration<f64_t, std::nano>(end - beg).count();
+
+    // spawned before this task counts as done, pending can't touch 0 in between
+    for (const auto succ : sys.successors) {
+        if (frame.waiting[succ].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            frame.pool->spawn(&run_system, ctx, succ, succ + 1, frame.pending);
+        }
+    }
+}
+
+template<typename... Component>
+component_mask scheduler::make_mask() {
+    component_mask ret;
+    ([&ret] {
+        const auto id = component_type_id<Component>::value();
+        if (id >= component_mask::max_components) {
+            LOG_ERR("Too many component types, component_mask holds %u", component_mask::max_components);
+            dbg::panic();
+        }
+        ret.set(id);
+    }(), ...);
+    return ret;
+}
+
+inline bool scheduler::intersects(const component_mask& l, const component_mask& r) noexcept {
+    bool ret = false;
+    l.for_each([&](u32_t id) { ret = ret || r.test(id); });
+    return ret;
+}
+
+inline bool scheduler::conflicts(const system& l, const system& r) noexcept {
+    return intersects(l.write, r.write) || intersects(l.write, r.read) || intersects(l.read, r.write);
+}
+
+inline void scheduler::build_graph() {
+    _enabled_count = 0;
+    for (auto& sys : _systems) {
+        sys.successors.clear();
+        sys.predecessor_count = 0;
+        _enabled_count += sys.enabled ? 1 : 0;
+    }
+    // NOTE : O(n^2) on change only, system counts are small
+    for (auto i = 0u; i < _systems.size(); ++i) {
+        if (!_systems[i].enabled) {
+            continue;
+        }
+        for (auto j = i + 1; j < _systems.size(); ++j) {
+            if (_systems[j].enabled && conflicts(_systems[i], _systems[j])) {
+                _systems[i].successors.push_back(j);
+                _systems[j].predecessor_count += 1;
+            }
+        }
+    }
+}
+
+inline void scheduler::update_critical_path() {
+    // edges only go forward, registration order is a topological order
+    std::vector<f64_t> finish(_systems.size(), 0);
+    _critical_path_ns = 0;
+    for (auto i = 0u; i < _systems.size(); ++i) {
+        if (!_systems[i].enabled) {
+            continue;
+        }
+        finish[i] += _systems[i].stats.duration_ns;
+        _critical_path_ns = (std::max)(_critical_path_ns, finish[i]);
+        for (const auto succ : _systems[i].successors) {
+            finish[succ] = (std::max)(finish[succ], finish[i]);
+        }
+    }
+}
+
+}
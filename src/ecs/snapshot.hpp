@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "util/num.hpp"
+#include "util/mapped_file.hpp"
+#include "dbg/log.hpp"
+
+#include "ecs.hpp"
+
+namespace dry::ecs {
+
+// stable across builds and runs where util::type_id isn't, derived from the name a type is added under
+constexpr u64_t snapshot_key(std::string_view name) noexcept {
+    u64_t hash = 14695981039346656037ull;
+    for (const char c : name) {
+        hash = (hash ^ static_cast<u8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// hook for components that aren't trivially copyable, specialize with
+//   static void save(const Component&, byte_vec& out);
+//   static Component load(const std::byte*& cursor);  advances cursor past what save wrote
+template<typename Component>
+struct snapshot_serializer;
+
+// binary image of an ec_registry, the entity slots and one blob per pool:
+// [header | slots | pool records | entities, components per pool], blobs 64 byte aligned
+// trivially copyable pools load with a single copy straight out of the mapped file
+class snapshot {
+public:
+    template<typename Component>
+    void add(std::string_view name);
+
+    byte_vec serialize(const ec_registry& registry) const;
+    bool save(const ec_registry& registry, const std::filesystem::path& path) const;
+    // NOTE : registry has to be empty, pools of types not added here are skipped with a warning
+    // a corrupt snapshot leaves the registry empty again
+    bool load(ec_registry& registry, const_byte_span bytes) const;
+    bool load(ec_registry& registry, const std::filesystem::path& path) const;
+
+private:
+    static constexpr u32_t magic = 0x53595244; // DRYS
+    static constexpr u32_t version = 1;
+    static constexpr u64_t blob_alignment = 64;
+
+    struct file_header {
+        u32_t magic;
+        u32_t version;
+        u32_t slot_count;
+        u32_t free_head;
+        u32_t alive;
+        u32_t pool_count;
+        u64_t slots_offset;
+        u64_t pools_offset;
+    };
+    struct pool_record {
+        u64_t key;
+        u32_t count;
+        u32_t trivial;
+        u64_t entities_offset;
+        u64_t data_offset;
+        u64_t data_size;
+    };
+    struct type_entry {
+        u64_t key;
+        u32_t component_id;
+        bool trivial;
+        void(*save)(const entity_set& set, byte_vec& out);
+        bool(*load)(ec_registry& registry, const entity* ents, u32_t count, const std::byte* data, u64_t size);
+    };
+
+    template<typename Component>
+    static void save_pool(const entity_set& set, byte_vec& out);
+    template<typename Component>
+    static bool load_pool(ec_registry& registry, const entity* ents, u32_t count, const std::byte* data, u64_t size);
+
+    static u64_t append(byte_vec& out, const void* data, u64_t size);
+    // live slots hold their own index, the free list covers the rest exactly once
+    static bool valid_slots(const entity* slots, u32_t count, u32_t free_head, u32_t alive) noexcept;
+    // every entity alive in the restored registry, once, and not in the pool yet
+    static bool valid_pool_entities(const ec_registry& registry, const entity* ents, u32_t count, u32_t component_id);
+    // drops whatever a failed load restored
+    static void reset(ec_registry& registry);
+    const type_entry* find_key(u64_t key) const noexcept;
+
+    std::vector<type_entry> _types;
+};
+
+
+
+// impl
+template<typename Component>
+void snapshot::add(std::string_view name) {
+    static_assert(alignof(Component) <= blob_alignment, "Component is aligned past the blob alignment");
+    const u64_t key = snapshot_key(name);
+    if (find_key(key) != nullptr) {
+        LOG_ERR("Snapshot type key %llu added twice", static_cast<unsigned long long>(key));
+        dbg::panic();
+    }
+    _types.push_back({
+        .key = key,
+        .component_id = ec_registry::component_type_id<Component>::value(),
+        .trivial = std::is_trivially_copyable_v<Component>,
+        .save = &save_pool<Component>,
+        .load = &load_pool<Component>
+    });
+}
+
+template<typename Component>
+void snapshot::save_pool(const entity_set& set, byte_vec& out) {
+    const auto& components = static_cast<const component_set<Component>&>(set);
+    if constexpr (std::is_trivially_copyable_v<Component>) {
+        const auto* bytes = reinterpret_cast<const std::byte*>(components.data());
+        out.insert(out.end(), bytes, bytes + u64_t{ components.size() } * sizeof(Component));
+    } else {
+        for (auto i = 0u; i < components.size(); ++i) {
+            snapshot_serializer<Component>::save(components.data()[i], out);
+        }
+    }
+}
+
+template<typename Component>
+bool snapshot::load_pool(ec_registry& registry, const entity* ents, u32_t count, const std::byte* data, u64_t size) {
+    if (!valid_pool_entities(registry, ents, count, ec_registry::component_type_id<Component>::value())) {
+        return false;
+    }
+    auto& pool = registry.assure<Component>();
+    if constexpr (std::is_trivially_copyable_v<Component>) {
+        if (size != u64_t{ count } * sizeof(Component)) {
+            return false;
+        }
+        pool.insert(ents, count, reinterpret_cast<const Component*>(data));
+    } else {
+        std::vector<Component> components;
+        components.reserve(count);
+        const std::byte* cursor = data;
+        for (auto i = 0u; i < count; ++i) {
+            components.push_back(snapshot_serializer<Component>::load(cursor));
+        }
+        if (cursor != data + size) {
+            return false;
+        }
+        pool.insert(ents, count, std::make_move_iterator(components.begin()));
+    }
+    registry.set_mask_bits(ents, count, ec_registry::component_type_id<Component>::value());
+    return true;
+}
+
+inline u64_t snapshot::append(byte_vec& out, const void* data, u64_t size) {
+    const u64_t offset = (out.size() + blob_alignment - 1) / blob_alignment * blob_alignment;
+    out.resize(offset + size);
+    if (size != 0) {
+        std::memcpy(out.data() + offset, data, size);
+    }
+    return offset;
+}
+
+inline bool snapshot::valid_slots(const entity* slots, u32_t count, u32_t free_head, u32_t alive) noexcept {
+    u32_t live = 0;
+    for (auto i = 0u; i < count; ++i) {
+        live += entity_index(slots[i]) == i ? 1 : 0;
+    }
+    if (live != alive) {
+        return false;
+    }
+    // bounded by the free slot count, a cycle runs out of steps
+    u32_t index = free_head;
+    for (auto steps = 0u; steps < count - alive; ++steps) {
+        if (index >= count || entity_index(slots[index]) == index) {
+            return false;
+        }
+        index = entity_index(slots[index]);
+    }
+    return index == entity_index_mask;
+}
+
+inline bool snapshot::valid_pool_entities(const ec_registry& registry, const entity* ents, u32_t count, u32_t component_id) {
+    std::vector<bool> seen(registry._entities.capacity());
+    for (auto i = 0u; i < count; ++i) {
+        const entity ent = ents[i];
+        if (!registry.valid(ent) || seen[entity_index(ent)] || registry._masks[entity_index(ent)].test(component_id)) {
+            return false;
+        }
+        seen[entity_index(ent)] = true;
+    }
+    return true;
+}
+
+inline void snapshot::reset(ec_registry& registry) {
+    for (auto& pool : registry._component_pools) {
+        if (pool && pool->size() != 0) {
+            // copy, the removal compacts the dense array under us
+            const std::vector<entity> ents(pool->data(), pool->data() + pool->size());
+            pool->remove_batch(ents.data(), static_cast<u32_t>(ents.size()));
+        }
+    }
+    registry._masks.clear();
+    registry._entities.restore(nullptr, 0, entity_index_mask, 0);
+}
+
+inline const snapshot::type_entry* snapshot::find_key(u64_t key) const noexcept {
+    for (const auto& type : _types) {
+        if (type.key == key) {
+            return &type;
+        }
+    }
+    return nullptr;
+}
+
+inline byte_vec snapshot::serialize(const ec_registry& registry) const {
+    std::vector<pool_record> pools;
+    std::vector<const type_entry*> pool_types;
+    for (auto id = 0u; id < registry._component_pools.size(); ++id) {
+        const auto& pool = registry._component_pools[id];
+        if (!pool || pool->size() == 0) {
+            continue;
+        }
+        const type_entry* type = nullptr;
+        for (const auto& entry : _types) {
+            if (entry.component_id == id) {
+                type = &entry;
+            }
+        }
+        if (type == nullptr) {
+            LOG_WRN("Component %u was not added to the snapshot, skipped", id);
+            continue;
+        }
+        pools.push_back({
+            .key = type->key,
+            .count = pool->size(),
+            .trivial = type->trivial,
+            .entities_offset = 0,
+            .data_offset = 0,
+            .data_size = 0
+        });
+        pool_types.push_back(type);
+    }
+
+    byte_vec out(sizeof(file_header));
+    file_header header{
+        .magic = magic,
+        .version = version,
+        .slot_count = registry._entities.capacity(),
+        .free_head = registry._entities.free_head(),
+        .alive = registry._entities.alive(),
+        .pool_count = static_cast<u32_t>(pools.size()),
+        .slots_offset = 0,
+        .pools_offset = 0
+    };
+    header.slots_offset = append(out, registry._entities.slots(), u64_t{ header.slot_count } * sizeof(entity));
+    // records are patched once the blob offsets are known
+    header.pools_offset = append(out, pools.data(), pools.size() * sizeof(pool_record));
+
+    byte_vec scratch;
+    for (auto i = 0u; i < pools.size(); ++i) {
+        const auto& set = *registry._component_pools[pool_types[i]->component_id];
+        pools[i].entities_offset = append(out, set.data(), u64_t{ set.size() } * sizeof(entity));
+
+        scratch.clear();
+        pool_types[i]->save(set, scratch);
+        pools[i].data_offset = append(out, scratch.data(), scratch.size());
+        pools[i].data_size = scratch.size();
+    }
+
+    std::memcpy(out.data(), &header, sizeof(header));
+    if (!pools.empty()) {
+        std::memcpy(out.data() + header.pools_offset, pools.data(), pools.size() * sizeof(pool_record));
+    }
+    return out;
+}
+
+inline bool snapshot::save(const ec_registry& registry, const std::filesystem::path& path) const {
+    const byte_vec bytes = serialize(registry);
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        LOG_ERR("Could not write snapshot %s", path.string().c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool snapshot::load(ec_registry& registry, const_byte_span bytes) const {
+    const auto in_bounds = [&bytes](u64_t offset, u64_t size) {
+        return offset <= bytes.size() && size <= bytes.size() - offset && offset % blob_alignment == 0;
+    };
+
+    if (registry._entities.capacity() != 0) {
+        LOG_ERR("Snapshot loaded into a registry that already handed out %u entities", registry._entities.capacity());
+        return false;
+    }
+    file_header header;
+    if (bytes.size() < sizeof(header)) {
+        LOG_ERR("Snapshot of %llu bytes is too small", static_cast<unsigned long long>(bytes.size()));
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != magic || header.version != version) {
+        LOG_ERR("Not a snapshot or version %u unsupported", header.version);
+        return false;
+    }
+    if (header.slot_count > max_entity_count || header.alive > header.slot_count
+        || !in_bounds(header.slots_offset, u64_t{ header.slot_count } * sizeof(entity))
+        || !in_bounds(header.pools_offset, u64_t{ header.pool_count } * sizeof(pool_record))) {
+        LOG_ERR("Snapshot with %u entities is truncated", header.slot_count);
+        return false;
+    }
+    if (!valid_slots(reinterpret_cast<const entity*>(bytes.data() + header.slots_offset), header.slot_count, header.free_head, header.alive)) {
+        LOG_ERR("Snapshot entity slots are corrupt, %u alive of %u", header.alive, header.slot_count);
+        return false;
+    }
+
+    registry._entities.restore(reinterpret_cast<const entity*>(bytes.data() + header.slots_offset),
+        header.slot_count, header.free_head, header.alive);
+    registry._masks.assign(header.slot_count, component_mask{});
+
+    for (auto i = 0u; i < header.pool_count; ++i) {
+        pool_record pool;
+        std::memcpy(&pool, bytes.data() + header.pools_offset + i * sizeof(pool_record), sizeof(pool));
+
+        const type_entry* type = find_key(pool.key);
+        if (type == nullptr) {
+            LOG_WRN("Snapshot pool %u has no matching type, skipped", i);
+            continue;
+        }
+        if (!in_bounds(pool.entities_offset, u64_t{ pool.count } * sizeof(entity)) || !in_bounds(pool.data_offset, pool.data_size)
+            || static_cast<bool>(pool.trivial) != type->trivial
+            || !type->load(registry, reinterpret_cast<const entity*>(bytes.data() + pool.entities_offset), pool.count,
+                bytes.data() + pool.data_offset, pool.data_size)) {
+            LOG_ERR("Snapshot pool %u is corrupt", i);
+            reset(registry);
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool snapshot::load(ec_registry& registry, const std::filesystem::path& path) const {
+    const mapped_file file{ path };
+    if (file.empty()) {
+        return false;
+    }
+    return load(registry, file.bytes());
+}
+
+}
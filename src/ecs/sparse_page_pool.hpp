@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+
+namespace dry::ecs {
+
+// fixed size sparse pages shared by every set of a registry, pages a set empties out
+// go back on the free list for any other set to reuse
+// NOTE : not thread safe, same as the structural changes that need pages
+class sparse_page_pool {
+public:
+    static constexpr uint32_t page_bytes = 1024;
+    static constexpr uint32_t pages_per_block = 64;
+
+    explicit sparse_page_pool(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _blocks{ resource }
+    {}
+    sparse_page_pool(const sparse_page_pool&) = delete;
+    sparse_page_pool& operator=(const sparse_page_pool&) = delete;
+    ~sparse_page_pool() {
+        for (auto* block : _blocks) {
+            resource()->deallocate(block, page_bytes * pages_per_block, page_bytes);
+        }
+    }
+
+    void* allocate() {
+        if (_free == nullptr) {
+            grow();
+        }
+        page* ret = _free;
+        _free = ret->next;
+        _used += 1;
+        return ret;
+    }
+    void deallocate(void* ptr) noexcept {
+        auto* freed = static_cast<page*>(ptr);
+        freed->next = _free;
+        _free = freed;
+        _used -= 1;
+    }
+
+    uint32_t used_pages() const noexcept {
+        return _used;
+    }
+    // what the pool holds from its resource, used or not
+    uint64_t reserved_bytes() const noexcept {
+        return uint64_t{ page_bytes } * pages_per_block * _blocks.size();
+    }
+    std::pmr::memory_resource* resource() const noexcept {
+        return _blocks.get_allocator().resource();
+    }
+
+private:
+    struct page {
+        page* next;
+    };
+
+    void grow() {
+        auto* block = static_cast<std::byte*>(resource()->allocate(page_bytes * pages_per_block, page_bytes));
+        _blocks.push_back(block);
+        for (auto i = pages_per_block; i-- > 0;) {
+            auto* fresh = reinterpret_cast<page*>(block + i * page_bytes);
+            fresh->next = _free;
+            _free = fresh;
+        }
+    }
+
+    std::pmr::vector<std::byte*> _blocks;
+    page* _free = nullptr;
+    uint32_t _used = 0;
+};
+
+}
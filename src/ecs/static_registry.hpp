@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <bitset>
+#include <tuple>
+#include <utility>
+#include <memory_resource>
+
+#include "util/num.hpp"
+#include "util/type.hpp"
+
+#include "entity.hpp"
+#include "pool_view.hpp"
+
+namespace dry::ecs {
+
+// registry over a component list known at compile time, the pools live inline in a tuple
+// and every lookup is resolved statically, ec_registry stays for components added at runtime
+template<typename... Component>
+class static_registry {
+    template<typename T>
+    static constexpr util::id_type component_index = util::type_index<T, Component...>();
+    using component_bits = std::bitset<sizeof...(Component)>;
+
+public:
+    explicit static_registry(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _entities{ resource },
+        _masks{ resource },
+        _pools{ pool_resource<Component>(resource)... }
+    {}
+    static_registry(const static_registry&) = delete;
+    static_registry& operator=(const static_registry&) = delete;
+
+    entity create() {
+        const entity ent = _entities.create();
+        if (entity_index(ent) >= _masks.size()) {
+            _masks.resize(entity_index(ent) + 1);
+        }
+        return ent;
+    }
+    // unrolled over the component list, only the pools in the entity's mask are touched
+    void destroy(entity ent) {
+        destroy_components(ent, std::index_sequence_for<Component...>{});
+        _masks[entity_index(ent)].reset();
+        _entities.destroy(ent);
+    }
+    bool valid(entity ent) const noexcept {
+        return _entities.valid(ent);
+    }
+    uint32_t alive() const noexcept {
+        return _entities.alive();
+    }
+
+    template<typename T, typename... Args>
+    void attach(entity ent, Args&&... args) {
+        pool<T>().emplace(ent, std::forward<Args>(args)...);
+        _masks[entity_index(ent)].set(component_index<T>);
+    }
+    template<typename T>
+    void detach(entity ent) {
+        pool<T>().remove(ent);
+        _masks[entity_index(ent)].reset(component_index<T>);
+    }
+    template<typename T>
+    bool has(entity ent) const noexcept {
+        return _masks[entity_index(ent)].test(component_index<T>);
+    }
+    template<typename T>
+    T& get(entity ent) {
+        return pool<T>().get(ent);
+    }
+    template<typename T>
+    T& patch(entity ent) {
+        return pool<T>().patch(ent);
+    }
+    template<typename T, typename Fun>
+    void patch(entity ent, Fun fun) {
+        pool<T>().patch(ent, std::move(fun));
+    }
+
+    // see ec_registry::advance_tick
+    uint32_t tick() const noexcept {
+        return _tick;
+    }
+    void advance_tick() noexcept {
+        _tick += 1;
+        std::apply([this](auto&... pools) { (pools.set_tick(_tick), ...); }, _pools);
+    }
+
+    template<typename... View_Comp>
+    component_view<View_Comp...> view() {
+        return { &pool<View_Comp>()... };
+    }
+
+    template<typename T>
+    component_set<T>& pool() noexcept {
+        return std::get<component_index<T>>(_pools);
+    }
+    template<typename T>
+    const component_set<T>& pool() const noexcept {
+        return std::get<component_index<T>>(_pools);
+    }
+
+private:
+    template<typename>
+    static std::pmr::memory_resource* pool_resource(std::pmr::memory_resource* resource) noexcept {
+        return resource;
+    }
+
+    using remove_thunk = void(*)(static_registry&, entity);
+    template<size_t I>
+    static void remove_component(static_registry& reg, entity ent) {
+        std::get<I>(reg._pools).remove(ent);
+    }
+    template<size_t... I>
+    static constexpr std::array<remove_thunk, sizeof...(I)> make_remove_thunks(std::index_sequence<I...>) noexcept {
+        return { &remove_component<I>... };
+    }
+    static constexpr auto remove_thunks = make_remove_thunks(std::index_sequence_for<Component...>{});
+
+    // walks the set bits only, cost follows the entity's component count instead of the list length
+    template<size_t... I>
+    void destroy_components(entity ent, std::index_sequence<I...>) {
+        const auto& mask = _masks[entity_index(ent)];
+        if constexpr (sizeof...(Component) <= 64) {
+            for (auto bits = static_cast<u64_t>(mask.to_ullong()); bits != 0; bits &= bits - 1) {
+                remove_thunks[std::countr_zero(bits)](*this, ent);
+            }
+        } else {
+            ((mask.test(I) ? std::get<I>(_pools).remove(ent) : void()), ...);
+        }
+    }
+
+    entity_allocator _entities;
+    std::pmr::vector<component_bits> _masks;
+    std::tuple<component_set<Component>...> _pools;
+    uint32_t _tick = 0;
+};
+
+}
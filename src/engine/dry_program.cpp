@@ -32,10 +32,16 @@ void renderable::commit_transform() {
 dry_program::dry_program(u32_t w, u32_t h) :
     _window{ w, h },
     _renderer{ _window },
-    _asset_reg{},
+    _registry{},
+    _pool_resource{},
+    _level_arena{ arena_resource::default_initial_size, &_pool_resource },
+    _asset_reg{ &_level_arena },
     _resource_adapter{ _asset_reg }
 {
     _resource_adapter.attach_renderer(_renderer);
+    _renderer.attach_registry(_registry);
+    // anything patched in the first frame is past it
+    _committed_tick = _registry.tick() - 1;
     glfwSetWindowUserPointer(_window.handle(), this);
 
     glfwSetInputMode(_window.handle(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -67,8 +73,10 @@ void dry_program::render_loop() {
         if (!update()) {
             break;
         }
+        _systems.run();
 
         update_camera();
+        commit_transforms();
 
         // clear input
         _mouse_input.dx = 0;
@@ -76,9 +84,17 @@ void dry_program::render_loop() {
         _wheel_delta = 0;
 
         _renderer.submit_frame();
+
+        _committed_tick = _registry.tick();
+        _registry.advance_tick();
     }
 }
 
+void dry_program::unload_level() {
+    _asset_reg.unload_all();
+    _level_arena.release();
+}
+
 renderable dry_program::create_renderable(res_index mesh, res_index material) {
     renderable rend;
     rend._handle = _renderer.create_renderable(material, mesh);
@@ -94,6 +110,29 @@ renderable dry_program::create_renderable(const std::string& mesh, res_index mat
     return create_renderable(_resource_adapter.get_resource_index<asset::mesh_asset>(_asset_reg.get<asset::mesh_asset>(mesh).hash), material);
 }
 
+ecs::entity dry_program::spawn_renderable(res_index mesh, res_index material) {
+    const auto ent = _registry.create();
+    _registry.attach<transform>(ent, transform{ .position{ 0, 0, 0 }, .scale{ 1, 1, 1 }, .rotation{ 0, 0, 0, 1 } });
+    _registry.attach<object_transform>(ent, object_transform{ .model = glm::mat4{ 1.0f } });
+    _registry.attach<mesh_material>(ent, _renderer.create_mesh_material(material, mesh));
+    return ent;
+}
+
+ecs::entity dry_program::spawn_renderable(const std::string& mesh, res_index material) {
+    return spawn_renderable(_resource_adapter.get_resource_index<asset::mesh_asset>(_asset_reg.get<asset::mesh_asset>(mesh).hash), material);
+}
+
+void dry_program::commit_transforms() {
+    // touched so the renderer uploads just these
+    auto& models = _registry.pool<object_transform>();
+    _registry.view<transform, object_transform>().each_changed<transform>(_committed_tick,
+        [&models](ecs::entity ent, const transform& trans, object_transform& model) {
+            model.model = glm::translate(glm::mat4{ 1.0f }, trans.position) * glm::scale(glm::mat4{ 1.0f }, trans.scale) * glm::toMat4(trans.rotation);
+            models.touch(ent);
+        }
+    );
+}
+
 void dry_program::update_camera() {
     const auto dir = _camera.trans.position + glm::normalize(glm::rotate(_camera.trans.rotation, { 0, 0, 1 }));
     const auto up = glm::rotate(_camera.trans.rotation, { 0, 1, 0 });
@@ -7,8 +7,10 @@
 
 #include <glm/gtx/quaternion.hpp>
 
+#include "util/memory.hpp"
 #include "graphics/renderer.hpp"
 #include "asset/asset_resource_adapter.hpp"
+#include "ecs/scheduler.hpp"
 
 namespace dry {
 
@@ -57,10 +59,19 @@ public:
 protected:
     // returning false terminates the loop
     virtual bool update() { return true; }
+    // ran each frame right after update(), non conflicting systems in parallel
+    ecs::scheduler& systems() { return _systems; }
 
     renderable create_renderable(res_index mesh, res_index material);
     renderable create_renderable(const std::string& mesh, res_index material);
 
+    // ecs renderables, an entity with transform, object_transform and mesh_material
+    // write transform through registry().patch, each frame turns the patched ones into object_transform
+    // NOTE : destroying the entity is all it takes to stop drawing it
+    ecs::ec_registry& registry() { return _registry; }
+    ecs::entity spawn_renderable(res_index mesh, res_index material);
+    ecs::entity spawn_renderable(const std::string& mesh, res_index material);
+
     template<typename T, typename... Ts>
     asset_index create_asset(Ts&&... args);
     template<typename T>
@@ -88,6 +99,10 @@ protected:
     template<typename T>
     T& get_shader_ubo(res_index shader, u32_t binding);
 
+    // unloads every asset and frees the level arena in one go, renderer resources stay
+    void unload_level();
+    std::pmr::memory_resource* level_resource() { return &_level_arena; }
+
     struct {
         transform trans{ .position{0,0,0}, .scale{ 1, 1, 1}, .rotation{ 0, 0, 0, 1 } }; // scale ignored
         f32_t fov = 90;
@@ -110,6 +125,7 @@ protected:
 
 private:
     void update_camera();
+    void commit_transforms();
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
     static void wheel_callback(GLFWwindow* window, double x, double y);
@@ -117,8 +133,16 @@ private:
 
     wsi::window _window;
     vulkan_renderer _renderer;
+    // after the renderer, goes away first so no signal reaches a destroyed renderer
+    ecs::ec_registry _registry;
+    // transforms patched after this tick still need their object_transform
+    u32_t _committed_tick = 0;
+    // arena chunks come from the pool so level switches reuse them
+    pool_resource _pool_resource;
+    arena_resource _level_arena;
     asset::asset_registry _asset_reg;
     asset::asset_resource_adapter _resource_adapter;
+    ecs::scheduler _systems;
 
     decltype(std::chrono::steady_clock::now()) _t0;
 
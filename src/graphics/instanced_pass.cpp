@@ -25,6 +25,7 @@ instanced_pass create_instanced_pass(const vkw::vk_device& device, u32_t frame_c
     pass.instanced_descriptor_pool = vkw::vk_descriptor_pool{ device, desc_pool_sizes, frame_count };
 
     pass.instance_descriptors.resize(frame_count);
+    pass.dirty_instances.resize(frame_count, bitmap{ instanced_pass::combined_instance_buffer_count });
     pass.instanced_descriptor_pool.create_sets(pass.instance_descriptors, pass.instanced_descriptor_layout.handle());
 
     std::array desc_writes = generate_array(layout_bindings, desc_write_from_binding);
@@ -7,6 +7,8 @@
 
 #include <glm/mat4x4.hpp>
 
+#include "util/bitmap.hpp"
+
 #include "vk_initers.hpp"
 
 #include "vkw/buffer.hpp"
@@ -35,6 +37,8 @@ struct instanced_pass {
     std::vector<vkw::vk_buffer> camera_transforms;
     std::vector<vkw::vk_buffer> instance_buffers;
     std::vector<VkDescriptorSet> instance_descriptors;
+    // staging slots written since the frame's instance buffer was last copied to
+    std::vector<bitmap> dirty_instances;
 
     vkw::vk_buffer instance_staging_buffer;
 
@@ -42,6 +46,8 @@ struct instanced_pass {
     vkw::vk_descriptor_pool instanced_descriptor_pool;
 
     static constexpr u32_t combined_instance_buffer_count = 4096 * 8; // TODO : hardcoded, shouldn't be
+    // dirty runs this close together go as one copy region, fewer regions for a few clean slots more
+    static constexpr u32_t instance_copy_gap = 4;
 
     static constexpr asset::vk_shader_data::layout_binding_info camera_layout_binding{
         .binding = 0,
@@ -4,6 +4,7 @@
 #include "renderer.hpp"
 
 #include <algorithm>
+#include <cstring>
 
 #include "dbg/log.hpp"
 
@@ -59,17 +60,54 @@ vulkan_renderer::vulkan_renderer(const wsi::window& window) {
 
 void vulkan_renderer::submit_frame() {
     // pre-sync operations, instance transform buffer
+    // the staging buffer keeps its contents, only changed slots are written and marked dirty
+    // ecs instances follow the renderables, ecs_first_instance is where they start
+    u32_t ecs_first_instance = 0;
+    u32_t instance_count = 0;
     {
         auto mapped_instances = _instanced_pass.instance_staging_buffer.map<instanced_pass::instance_input>();
 
-        u32_t object_count = 0;
-        for (const auto& pipeline : _resources.pipelines) {
-            for (const auto& [mesh, renderables] : pipeline.renderables) {
-                // TODO: not a single memcpy call
-                std::copy(renderables.begin(), renderables.end(), &mapped_instances[object_count]);
-                object_count += static_cast<u32_t>(renderables.size());
+        if (_classic_instances.layout_dirty) {
+            u32_t object_count = 0;
+            for (auto& pipeline : _resources.pipelines) {
+                for (const auto& [mesh, renderables] : pipeline.renderables) {
+                    auto& slots = pipeline.instance_slots[mesh];
+                    slots.assign(renderables.end().index(), 0);
+                    renderables.for_each_run([&](u64_t first, std::span<const renderer_resources::renderable> run) {
+                        std::memcpy(&mapped_instances[object_count], run.data(), run.size_bytes());
+                        for (auto k = 0u; k < run.size(); ++k) {
+                            slots[first + k] = object_count + k;
+                        }
+                        object_count += static_cast<u32_t>(run.size());
+                    });
+                }
+            }
+            mark_instances_dirty(0, object_count);
+            if (object_count != _classic_instances.count) {
+                _ecs.layout_dirty = true;
+            }
+            _classic_instances.count = object_count;
+            _classic_instances.layout_dirty = false;
+        } else {
+            for (const auto rend : _classic_instances.moved) {
+                auto& pipeline = _resources.pipelines[rend.pipeline];
+                const u32_t slot = pipeline.instance_slots.at(rend.mesh)[rend.renderable];
+                mapped_instances[slot] = pipeline.renderables.at(rend.mesh)[rend.renderable];
+                mark_instances_dirty(slot, slot + 1);
             }
         }
+        _classic_instances.moved.clear();
+
+        ecs_first_instance = _classic_instances.count;
+        instance_count = ecs_first_instance;
+        if (_ecs.registry != nullptr) {
+            if (_ecs.order_dirty) {
+                sort_ecs_renderables();
+            }
+            instance_count += stream_ecs_renderables(&mapped_instances[ecs_first_instance], ecs_first_instance,
+                instanced_pass::combined_instance_buffer_count - ecs_first_instance
+            );
+        }
 
         _instanced_pass.instance_staging_buffer.unmap();
     }
@@ -84,12 +122,7 @@ void vulkan_renderer::submit_frame() {
 
     // === instance transfer ===
 
-    const auto instance_transfer_cmd = _transfer_queue.create_buffer();
-    instance_transfer_cmd.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    vkw::copy_buffer(instance_transfer_cmd, _instanced_pass.instance_staging_buffer.handle(),
-        _instanced_pass.instance_buffers[frame_index].handle(), _instanced_pass.instance_staging_buffer.size()
-    );
-    _transfer_queue.submit(instance_transfer_cmd);
+    record_instance_transfer(frame_index, instance_count);
 
     // === misc transfers and updates ===
 
@@ -102,12 +135,27 @@ void vulkan_renderer::submit_frame() {
     u32_t object_count = 0;
     constexpr std::array<VkDeviceSize, 1> offsets{ 0 };
 
+    auto draw_mesh = [&](resource_id mesh, u32_t instance_count, u32_t first_instance) {
+        const auto& vertex_buffer = _resources.vertex_buffers[mesh];
+        const auto vertex_buffer_h = vertex_buffer.vertices.handle();
+
+        vkCmdBindVertexBuffers(cmd_buffer_h, 0, 1, &vertex_buffer_h, offsets.data());
+        vkCmdBindIndexBuffer(cmd_buffer_h, vertex_buffer.indices.handle(), 0, VK_INDEX_TYPE_UINT32);
+
+        vkCmdDrawIndexed(cmd_buffer_h, static_cast<u32_t>(vertex_buffer.indices.size() / sizeof(u32_t)),
+            instance_count, 0, 0, first_instance
+        );
+    };
+    // batches are sorted by pipeline, the loop below walks them once
+    auto ecs_batch_it = _ecs.batches.cbegin();
+
     // TODO : if no transfer, this new buffer and begin is for nothing
     const auto ubo_transfer_cmd = _transfer_queue.create_buffer();
     ubo_transfer_cmd.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     bool ubo_transfer_present = false;
 
-    for (auto& pipeline : _resources.pipelines) {
+    for (auto pipeline_it = _resources.pipelines.begin(); pipeline_it != _resources.pipelines.end(); ++pipeline_it) {
+        auto& pipeline = *pipeline_it;
         // check if material buffers are up to date, don't like it TODO :
         if (pipeline.pipeline_data.has_materials() && !pipeline.material_update_status[frame_index]) {
             auto* material_buffer = pipeline.pipeline_data.ssbo_data(frame_index, pipeline_resources::material_ssbo_location);
@@ -147,17 +195,16 @@ void vulkan_renderer::submit_frame() {
         pipeline.pipeline_data.bind_resources(frame_index, cmd_buffer_h, pipeline.pipeline.layout());
 
         for (const auto& [mesh, renderables] : pipeline.renderables) {
-            const auto& vertex_buffer = _resources.vertex_buffers[mesh];
-            const auto vertex_buffer_h = vertex_buffer.vertices.handle();
-
-            vkCmdBindVertexBuffers(cmd_buffer_h, 0, 1, &vertex_buffer_h, offsets.data());
-            vkCmdBindIndexBuffer(cmd_buffer_h, vertex_buffer.indices.handle(), 0, VK_INDEX_TYPE_UINT32);
-
-            vkCmdDrawIndexed(cmd_buffer_h, static_cast<u32_t>(vertex_buffer.indices.size() / sizeof(u32_t)),
-                static_cast<u32_t>(renderables.size()), 0, 0, object_count
-            );
+            draw_mesh(mesh, static_cast<u32_t>(renderables.size()), object_count);
             object_count += static_cast<u32_t>(renderables.size());
         }
+        // batches of pipelines the loop never visited would hold back every later one
+        while (ecs_batch_it != _ecs.batches.cend() && ecs_batch_it->pipeline < pipeline_it.index()) {
+            ++ecs_batch_it;
+        }
+        for (; ecs_batch_it != _ecs.batches.cend() && ecs_batch_it->pipeline == pipeline_it.index(); ++ecs_batch_it) {
+            draw_mesh(ecs_batch_it->mesh, ecs_batch_it->count, ecs_first_instance + ecs_batch_it->first);
+        }
     }
 
     vkCmdEndRenderPass(cmd_buffer_h);
@@ -172,6 +219,121 @@ void vulkan_renderer::submit_frame() {
     _swapchain.submit_frame(_present_queue.handle(), frame_index, cmd_buffer_h);
 }
 
+void vulkan_renderer::on_ecs_structure(ecs::entity_set&, ecs::entity) {
+    _ecs.order_dirty = true;
+}
+
+void vulkan_renderer::sort_ecs_renderables() {
+    auto& registry = *_ecs.registry;
+    auto& tags = registry.pool<mesh_material>();
+
+    registry.sort<mesh_material>([](const mesh_material& tag) {
+        return u32_t{ tag.pipeline } << 16 | tag.mesh;
+    });
+    registry.sort_as<object_transform, mesh_material>();
+
+#ifdef DEBUG
+    const auto& transforms = registry.pool<object_transform>();
+    for (auto i = 0u; i < tags.size(); ++i) {
+        if (i >= transforms.size() || transforms.entity_set::data()[i] != tags.entity_set::data()[i]) {
+            LOG_ERR("Entity %u has a mesh_material but no object_transform", tags.entity_set::data()[i]);
+            dbg::panic();
+        }
+    }
+#endif
+
+    _ecs.batches.clear();
+    const mesh_material* tag_data = tags.data();
+    for (auto i = 0u; i < tags.size(); ++i) {
+        if (_ecs.batches.empty() || _ecs.batches.back().pipeline != tag_data[i].pipeline || _ecs.batches.back().mesh != tag_data[i].mesh) {
+            _ecs.batches.push_back({ .pipeline = tag_data[i].pipeline, .mesh = tag_data[i].mesh, .first = i, .count = 0 });
+        }
+        _ecs.batches.back().count += 1;
+    }
+    _ecs.order_dirty = false;
+    _ecs.layout_dirty = true;
+}
+
+u32_t vulkan_renderer::stream_ecs_renderables(instanced_pass::instance_input* dst, u32_t first_instance, u32_t capacity) {
+    auto& registry = *_ecs.registry;
+    const auto& tags = registry.pool<mesh_material>();
+    const auto& transforms = registry.pool<object_transform>();
+
+    // sorted, the first tags.size() transforms line up with the tags
+    const u32_t count = tags.size();
+    if (count > capacity) {
+        LOG_ERR("%u ecs renderables exceed the %u free instance slots", count, capacity);
+        dbg::panic();
+    }
+    const mesh_material* tag_data = tags.data();
+    const object_transform* transform_data = transforms.data();
+    if (_ecs.layout_dirty) {
+        for (auto i = 0u; i < count; ++i) {
+            dst[i].transform = transform_data[i];
+            dst[i].material = tag_data[i].material;
+        }
+        mark_instances_dirty(first_instance, first_instance + count);
+    } else {
+        // tags can't change without a resort, only the transforms are checked
+        const u32_t* ticks = transforms.ticks();
+        for (auto i = 0u; i < count; ++i) {
+            if (ecs::entity_set::tick_after(ticks[i], _ecs.synced_tick)) {
+                dst[i].transform = transform_data[i];
+                mark_instances_dirty(first_instance + i, first_instance + i + 1);
+            }
+        }
+    }
+    _ecs.layout_dirty = false;
+    _ecs.synced_tick = registry.tick();
+    return count;
+}
+
+void vulkan_renderer::mark_instances_dirty(u32_t first, u32_t last) {
+    for (auto& dirty : _instanced_pass.dirty_instances) {
+        dirty.set_range(first, last);
+    }
+}
+
+void vulkan_renderer::record_instance_transfer(u32_t frame_index, u32_t instance_count) {
+    constexpr u64_t instance_size = sizeof(instanced_pass::instance_input);
+    auto& dirty = _instanced_pass.dirty_instances[frame_index];
+
+    _instance_copy_regions.clear();
+    dirty.for_each_run(instance_count, [this](u64_t first, u64_t last) {
+        if (!_instance_copy_regions.empty()) {
+            auto& prev = _instance_copy_regions.back();
+            const u64_t prev_last = (prev.srcOffset + prev.size) / instance_size;
+            if (first - prev_last <= instanced_pass::instance_copy_gap) {
+                prev.size = (last - prev.srcOffset / instance_size) * instance_size;
+                return;
+            }
+        }
+        _instance_copy_regions.push_back(VkBufferCopy{
+            .srcOffset = first * instance_size,
+            .dstOffset = first * instance_size,
+            .size = (last - first) * instance_size
+        });
+    });
+    // slots past instance_count aren't drawn, they get rewritten before they are again
+    dirty.clear();
+
+    _stats.instance_transfer_bytes = 0;
+    _stats.instance_copy_regions = static_cast<u32_t>(_instance_copy_regions.size());
+    if (_instance_copy_regions.empty()) {
+        return;
+    }
+    for (const auto& region : _instance_copy_regions) {
+        _stats.instance_transfer_bytes += region.size;
+    }
+
+    const auto instance_transfer_cmd = _transfer_queue.create_buffer();
+    instance_transfer_cmd.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    vkw::copy_buffer_regions(instance_transfer_cmd, _instanced_pass.instance_staging_buffer.handle(),
+        _instanced_pass.instance_buffers[frame_index].handle(), _instance_copy_regions
+    );
+    _transfer_queue.submit(instance_transfer_cmd);
+}
+
 VkPhysicalDevice vulkan_renderer::find_physical_device() {
     static constexpr VkQueueFlags device_queue_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT;
 
@@ -7,10 +7,14 @@
 #include <memory>
 
 #include "util/sparse_array.hpp"
+#include "util/paged_sparse_array.hpp"
 #include "util/sparse_table.hpp"
+#include "util/trans_hashmap.hpp"
 
 #include "window/window.hpp"
 
+#include "ecs/ecs.hpp"
+
 #include "vkw/device/instance.hpp"
 #include "vkw/device/surface.hpp"
 #include "vkw/swapchain_p.hpp"
@@ -26,6 +30,14 @@
 
 namespace dry {
 
+// ecs renderable, every entity with this and an object_transform in the attached registry is drawn
+// the transforms go to the instance buffer straight from the registry's column
+struct mesh_material {
+    u16_t pipeline;
+    u16_t mesh;
+    u32_t material; // local to the pipeline, same as instance_input::material
+};
+
 struct renderer_resources {
     // TODO: type of sparse containers
     using resource_id = u64_t;
@@ -41,7 +53,10 @@ struct renderer_resources {
         pipeline_resources pipeline_data;
 
         std::vector<std::vector<VkDescriptorSet>> shared_descriptors;
-        std::unordered_map<resource_id, sparse_array<renderable>> renderables;
+        // paged, bursts of spawns don't relocate every instance
+        flat_map<resource_id, paged_sparse_array<renderable>> renderables;
+        // instance buffer slot per renderable index, rebuilt on every repack
+        flat_map<resource_id, std::vector<u32_t>> instance_slots;
 
         sparse_array<resource_id> material_inds; // TODO : too much redundant info
         // update statuses, getting cluttered TODO :
@@ -68,6 +83,11 @@ public:
         u16_t pipeline;
         u16_t mesh;
     };
+    // of the last submit_frame
+    struct frame_stats {
+        u64_t instance_transfer_bytes = 0;
+        u32_t instance_copy_regions = 0;
+    };
 
     vulkan_renderer(const wsi::window& window);
     ~vulkan_renderer() { _device.wait_on_device(); }
@@ -86,9 +106,18 @@ public:
     void update_renderable_transform(renderable_id rend, const object_transform& trans);
     void update_camera_transform(const camera_transform& trans);
 
+    // ecs mode, drawn after the renderables above
+    // only transforms patched since the previous frame are uploaded, the registry's tick has to advance after every submit_frame
+    // NOTE : the registry is read by every submit_frame until detached, it has to stay alive until then
+    void attach_registry(ecs::ec_registry& registry);
+    void detach_registry();
+    mesh_material create_mesh_material(resource_id material, resource_id mesh) const;
+
     template<typename T>
     T& get_ubo(resource_id pipeline, u32_t binding);
 
+    const frame_stats& stats() const { return _stats; }
+
 private:
     friend class pipeline_base;
     // internal types for init, not used after
@@ -106,6 +135,23 @@ private:
     // return queue infos and and family-index pair for each used queue
     populated_queue_info populate_queue_infos(VkPhysicalDevice phys_device);
 
+    // ecs mode, consecutive mesh_material entities sharing pipeline and mesh
+    struct ecs_batch {
+        u16_t pipeline;
+        u16_t mesh;
+        u32_t first;
+        u32_t count;
+    };
+    void on_ecs_structure(ecs::entity_set&, ecs::entity);
+    // sorts the tags by pipeline and mesh, the transforms after them, and rebuilds the batches
+    void sort_ecs_renderables();
+    // writes the instances changed since the last frame, every one if the layout moved
+    u32_t stream_ecs_renderables(instanced_pass::instance_input* dst, u32_t first_instance, u32_t capacity);
+    // staging slots [first, last) changed, every frame's instance buffer needs them
+    void mark_instances_dirty(u32_t first, u32_t last);
+    // coalesced copy of the frame's dirty slots below instance_count, nothing is recorded if none
+    void record_instance_transfer(u32_t frame_index, u32_t instance_count);
+
     static const vkw::vk_instance& vk_instance();
     static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
         VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -128,6 +174,27 @@ private:
 
     renderer_resources _resources;
 
+    struct {
+        ecs::ec_registry* registry = nullptr;
+        std::vector<ecs_batch> batches;
+        // set by the pools' construct and destroy signals, sorting waits for the next frame
+        bool order_dirty = false;
+        // instances moved, every one is rewritten
+        bool layout_dirty = false;
+        // registry tick of the last stream, later patches are uploaded
+        u32_t synced_tick = 0;
+    } _ecs;
+
+    // renderables are repacked whole on create and destroy, a transform update rewrites its own slot
+    struct {
+        u32_t count = 0;
+        bool layout_dirty = true;
+        std::vector<renderable_id> moved;
+    } _classic_instances;
+
+    std::vector<VkBufferCopy> _instance_copy_regions;
+    frame_stats _stats;
+
     instanced_pass _instanced_pass;
 
     texture_array _texarr;
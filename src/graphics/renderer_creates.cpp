@@ -139,21 +139,62 @@ vulkan_renderer::renderable_id vulkan_renderer::create_renderable(resource_id ma
     rend.renderable = static_cast<u32_t>(
         _resources.pipelines[rend.pipeline].renderables[mesh].emplace(_default_transform, static_cast<u32_t>(material_data.local_index))
     );
+    _classic_instances.layout_dirty = true;
 
     return rend;
 }
 
 void vulkan_renderer::destroy_renderable(renderable_id rend) {
     _resources.pipelines[rend.pipeline].renderables[rend.mesh].remove(rend.renderable);
+    _classic_instances.layout_dirty = true;
 
     // TODO : cleanup and refcounting
 }
 
 void vulkan_renderer::update_renderable_transform(renderable_id rend, const object_transform& trans) {
     _resources.pipelines[rend.pipeline].renderables[rend.mesh][rend.renderable].transform = trans;
+    // slots stay put until the next create or destroy, the repack then covers it anyway
+    if (!_classic_instances.layout_dirty) {
+        _classic_instances.moved.push_back(rend);
+    }
 }
 void vulkan_renderer::update_camera_transform(const camera_transform& trans) {
     _resources.cam_transform = trans;
 }
 
+void vulkan_renderer::attach_registry(ecs::ec_registry& registry) {
+    detach_registry();
+    _ecs.registry = &registry;
+    // both pools matter, an entity is drawn once it has the two, a patched tag may change batch
+    registry.on_construct<mesh_material>().connect<&vulkan_renderer::on_ecs_structure>(*this);
+    registry.on_destroy<mesh_material>().connect<&vulkan_renderer::on_ecs_structure>(*this);
+    registry.on_update<mesh_material>().connect<&vulkan_renderer::on_ecs_structure>(*this);
+    registry.on_construct<object_transform>().connect<&vulkan_renderer::on_ecs_structure>(*this);
+    registry.on_destroy<object_transform>().connect<&vulkan_renderer::on_ecs_structure>(*this);
+    _ecs.order_dirty = true;
+}
+
+void vulkan_renderer::detach_registry() {
+    if (_ecs.registry == nullptr) {
+        return;
+    }
+    _ecs.registry->on_construct<mesh_material>().disconnect(this);
+    _ecs.registry->on_destroy<mesh_material>().disconnect(this);
+    _ecs.registry->on_update<mesh_material>().disconnect(this);
+    _ecs.registry->on_construct<object_transform>().disconnect(this);
+    _ecs.registry->on_destroy<object_transform>().disconnect(this);
+    _ecs.registry = nullptr;
+    _ecs.batches.clear();
+}
+
+mesh_material vulkan_renderer::create_mesh_material(resource_id material, resource_id mesh) const {
+    // NOTE : same narrowing as create_renderable
+    const auto& material_data = *_resources.materials[material];
+    return mesh_material{
+        .pipeline = static_cast<u16_t>(material_data.pipeline_index),
+        .mesh = static_cast<u16_t>(mesh),
+        .material = static_cast<u32_t>(material_data.local_index)
+    };
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef DRY_UTIL_BITMAP_H
+#define DRY_UTIL_BITMAP_H
+
+#include <limits>
+#include <vector>
+#include <memory_resource>
+#include <algorithm>
+#include <bit>
+
+#include "num.hpp"
+
+namespace dry {
+
+// occupancy bitmap, scans a whole word at a time
+class bitmap {
+public:
+    using word_t = u64_t;
+    static constexpr u64_t word_bits = sizeof(word_t) * 8;
+    static constexpr u64_t npos = (std::numeric_limits<u64_t>::max)();
+
+    bitmap(u64_t bit_count = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _words{ resource }
+    {
+        resize(bit_count);
+    }
+
+    // new bits are unset
+    void resize(u64_t bit_count) {
+        _words.resize(word_count(bit_count), 0);
+    }
+    void clear() noexcept {
+        std::fill(_words.begin(), _words.end(), 0);
+    }
+    // rounded up to word size
+    u64_t size() const noexcept {
+        return _words.size() * word_bits;
+    }
+
+    bool test(u64_t bit) const noexcept {
+        return _words[bit / word_bits] & word_mask(bit);
+    }
+    void set(u64_t bit) noexcept {
+        _words[bit / word_bits] |= word_mask(bit);
+    }
+    void reset(u64_t bit) noexcept {
+        _words[bit / word_bits] &= ~word_mask(bit);
+    }
+    // sets [first, last), whole words at a time in between
+    void set_range(u64_t first, u64_t last) noexcept {
+        for (; first < last && first % word_bits != 0; ++first) {
+            set(first);
+        }
+        for (; first + word_bits <= last; first += word_bits) {
+            _words[first / word_bits] = npos;
+        }
+        for (; first < last; ++first) {
+            set(first);
+        }
+    }
+
+    // first set bit in [from, last), last if none
+    u64_t find_next(u64_t from, u64_t last) const noexcept {
+        return find_next_impl<false>(from, last);
+    }
+    // first unset bit in [from, last), last if none
+    u64_t find_next_unset(u64_t from, u64_t last) const noexcept {
+        return find_next_impl<true>(from, last);
+    }
+    // last set bit in [0, from], npos if none
+    u64_t find_prev(u64_t from) const noexcept {
+        if (from == npos) {
+            return npos;
+        }
+        u64_t word_ind = from / word_bits;
+        // keep bits [0, from % word_bits]
+        word_t word = _words[word_ind] & (npos >> (word_bits - 1 - from % word_bits));
+
+        while (word == 0) {
+            if (word_ind == 0) {
+                return npos;
+            }
+            word = _words[--word_ind];
+        }
+        return word_ind * word_bits + (word_bits - 1 - std::countl_zero(word));
+    }
+
+    // calls fun(first, last) for every maximal run of set bits in [0, last)
+    template<typename Fun>
+    void for_each_run(u64_t last, Fun fun) const {
+        u64_t run_beg = find_next(0, last);
+        while (run_beg != last) {
+            const u64_t run_end = find_next_unset(run_beg, last);
+            fun(run_beg, run_end);
+            run_beg = find_next(run_end, last);
+        }
+    }
+
+    const word_t* data() const noexcept {
+        return _words.data();
+    }
+
+private:
+    static constexpr u64_t word_count(u64_t bit_count) noexcept {
+        return (bit_count + word_bits - 1) / word_bits;
+    }
+    static constexpr word_t word_mask(u64_t bit) noexcept {
+        return word_t{ 1 } << (bit % word_bits);
+    }
+
+    template<bool Invert>
+    u64_t find_next_impl(u64_t from, u64_t last) const noexcept {
+        if (from >= last) {
+            return last;
+        }
+        const u64_t last_word = word_count(last);
+        u64_t word_ind = from / word_bits;
+        word_t word = (Invert ? ~_words[word_ind] : _words[word_ind]) & (npos << (from % word_bits));
+
+        while (word == 0) {
+            if (++word_ind >= last_word) {
+                return last;
+            }
+            word = Invert ? ~_words[word_ind] : _words[word_ind];
+        }
+        return (std::min)(word_ind * word_bits + std::countr_zero(word), last);
+    }
+
+    std::pmr::vector<word_t> _words;
+};
+
+}
+
+#endif
@@ -0,0 +1,258 @@
+#pragma once
+
+#ifndef DRY_UTIL_CONCURRENT_SPARSE_TABLE_H
+#define DRY_UTIL_CONCURRENT_SPARSE_TABLE_H
+
+#include <atomic>
+#include <array>
+#include <bit>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <cstddef>
+
+#include "num.hpp"
+#include "dbg/log.hpp"
+
+namespace dry {
+
+// sparse_table that can be emplaced into and removed from by several threads at once
+// free slots form a lock-free stack with a tagged head, storage is a list of
+// geometrically growing segments that are published once and never move,
+// so operator[] on a live index is wait-free
+// NOTE : the resource is shared by all threads, it has to be thread safe itself
+// NOTE : the free stack links slots by u32, indices stay below max_size
+template<typename T>
+class concurrent_sparse_table {
+public:
+    using index_t = u64_t;
+    static constexpr index_t index_null = (std::numeric_limits<index_t>::max)();
+    static constexpr index_t max_size = (std::numeric_limits<u32_t>::max)();
+
+    explicit concurrent_sparse_table(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept;
+    concurrent_sparse_table(const concurrent_sparse_table&) = delete;
+    ~concurrent_sparse_table();
+
+    // NOTE : not thread safe, both need exclusive access
+    void clear();
+    // calls fun(index, value) or fun(value) for every live element in index order
+    template<typename Fun>
+    void for_each(Fun fun);
+
+    u64_t size() const noexcept;
+    std::pmr::memory_resource* resource() const noexcept;
+
+    template<typename... Args>
+    index_t emplace(Args&&... args);
+    void remove(index_t index);
+
+    bool contains(index_t index) const noexcept;
+
+    const T& operator[](index_t index) const noexcept;
+    T& operator[](index_t index) noexcept;
+
+    concurrent_sparse_table& operator=(const concurrent_sparse_table&) = delete;
+
+private:
+    struct slot {
+        alignas(T) std::byte storage[sizeof(T)];
+        std::atomic<u32_t> next_available{ u32_null };
+        std::atomic<bool> live{ false };
+
+        T* value() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+        const T* value() const noexcept { return std::launder(reinterpret_cast<const T*>(storage)); }
+    };
+
+    static constexpr u32_t u32_null = (std::numeric_limits<u32_t>::max)();
+    // segment k holds first_segment_capacity << k slots, enough segments to cover max_size
+    static constexpr u64_t first_segment_capacity = 64;
+    static constexpr u64_t max_segments = 27;
+
+    static constexpr u64_t segment_of(index_t index) noexcept {
+        return std::bit_width(index / first_segment_capacity + 1) - 1;
+    }
+    static constexpr u64_t segment_begin(u64_t segment) noexcept {
+        return first_segment_capacity * ((1ull << segment) - 1);
+    }
+    static constexpr u64_t segment_capacity(u64_t segment) noexcept {
+        return first_segment_capacity << segment;
+    }
+
+    // tag in the high half against ABA, index in the low half
+    static constexpr u64_t pack(u64_t tag, u32_t index) noexcept { return (tag << 32) | index; }
+    static constexpr u32_t index_of(u64_t head) noexcept { return static_cast<u32_t>(head); }
+    static constexpr u64_t tag_of(u64_t head) noexcept { return head >> 32; }
+
+    slot& slot_at(index_t index) const noexcept;
+    // publishes segment if no other thread did yet
+    void ensure_segment(u64_t segment);
+
+    std::pmr::memory_resource* _resource;
+    std::array<std::atomic<slot*>, max_segments> _segments{};
+    std::atomic<u64_t> _available{ pack(0, u32_null) };
+    std::atomic<u64_t> _head{ 0 };
+    std::atomic<u64_t> _size{ 0 };
+};
+
+
+
+// impl
+template<typename T>
+concurrent_sparse_table<T>::concurrent_sparse_table(std::pmr::memory_resource* resource) noexcept :
+    _resource{ resource }
+{
+    static_assert(segment_begin(max_segments) >= max_size, "segments don't cover every index below max_size");
+}
+
+template<typename T>
+concurrent_sparse_table<T>::~concurrent_sparse_table() {
+    clear();
+    for (auto i = 0ull; i < max_segments; ++i) {
+        slot* seg = _segments[i].load(std::memory_order_relaxed);
+        if (seg == nullptr) {
+            continue;
+        }
+        std::destroy_n(seg, segment_capacity(i));
+        _resource->deallocate(seg, sizeof(slot) * segment_capacity(i), alignof(slot));
+    }
+}
+
+template<typename T>
+void concurrent_sparse_table<T>::clear() {
+    const u64_t head = _head.load(std::memory_order_acquire);
+    for (auto i = 0ull; i < head; ++i) {
+        slot& sl = slot_at(i);
+        if (sl.live.load(std::memory_order_relaxed)) {
+            std::destroy_at(sl.value());
+            sl.live.store(false, std::memory_order_relaxed);
+        }
+    }
+    // segments are kept, the free stack restarts from the bottom
+    _available.store(pack(0, u32_null), std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+    _size.store(0, std::memory_order_release);
+}
+
+template<typename T>
+template<typename Fun>
+void concurrent_sparse_table<T>::for_each(Fun fun) {
+    const u64_t head = _head.load(std::memory_order_acquire);
+    for (auto i = 0ull; i < head; ++i) {
+        slot& sl = slot_at(i);
+        if (!sl.live.load(std::memory_order_acquire)) {
+            continue;
+        }
+        if constexpr (std::is_invocable_v<Fun, index_t, T&>) {
+            fun(i, *sl.value());
+        } else {
+            fun(*sl.value());
+        }
+    }
+}
+
+template<typename T>
+u64_t concurrent_sparse_table<T>::size() const noexcept {
+    return _size.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+std::pmr::memory_resource* concurrent_sparse_table<T>::resource() const noexcept {
+    return _resource;
+}
+
+template<typename T>
+template<typename... Args>
+concurrent_sparse_table<T>::index_t concurrent_sparse_table<T>::emplace(Args&&... args) {
+    index_t ret_pos = index_null;
+
+    // pop a recycled slot
+    u64_t available = _available.load(std::memory_order_acquire);
+    while (index_of(available) != u32_null) {
+        // NOTE : may read a stale link if another thread popped first, the tag makes the cas fail then
+        const u32_t next = slot_at(index_of(available)).next_available.load(std::memory_order_relaxed);
+        if (_available.compare_exchange_weak(available, pack(tag_of(available) + 1, next),
+            std::memory_order_acquire, std::memory_order_acquire))
+        {
+            ret_pos = index_of(available);
+            break;
+        }
+    }
+    // or take a fresh one
+    if (ret_pos == index_null) {
+        ret_pos = _head.fetch_add(1, std::memory_order_relaxed);
+        if (ret_pos >= max_size) {
+            LOG_ERR("concurrent_sparse_table limit of %llu slots exceeded", static_cast<unsigned long long>(max_size));
+            dbg::panic();
+        }
+        ensure_segment(segment_of(ret_pos));
+    }
+
+    slot& sl = slot_at(ret_pos);
+    std::construct_at(sl.value(), std::forward<Args>(args)...);
+    sl.live.store(true, std::memory_order_release);
+    _size.fetch_add(1, std::memory_order_relaxed);
+
+    return ret_pos;
+}
+
+template<typename T>
+void concurrent_sparse_table<T>::remove(index_t index) {
+    slot& sl = slot_at(index);
+    sl.live.store(false, std::memory_order_relaxed);
+    std::destroy_at(sl.value());
+    _size.fetch_sub(1, std::memory_order_relaxed);
+
+    u64_t available = _available.load(std::memory_order_relaxed);
+    do {
+        sl.next_available.store(index_of(available), std::memory_order_relaxed);
+    } while (!_available.compare_exchange_weak(available, pack(tag_of(available) + 1, static_cast<u32_t>(index)),
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
+template<typename T>
+bool concurrent_sparse_table<T>::contains(index_t index) const noexcept {
+    return index < _head.load(std::memory_order_acquire)
+        && _segments[segment_of(index)].load(std::memory_order_acquire) != nullptr
+        && slot_at(index).live.load(std::memory_order_acquire);
+}
+
+template<typename T>
+const T& concurrent_sparse_table<T>::operator[](index_t index) const noexcept {
+    return *slot_at(index).value();
+}
+
+template<typename T>
+T& concurrent_sparse_table<T>::operator[](index_t index) noexcept {
+    return *slot_at(index).value();
+}
+
+template<typename T>
+concurrent_sparse_table<T>::slot& concurrent_sparse_table<T>::slot_at(index_t index) const noexcept {
+    const u64_t segment = segment_of(index);
+    return _segments[segment].load(std::memory_order_acquire)[index - segment_begin(segment)];
+}
+
+template<typename T>
+void concurrent_sparse_table<T>::ensure_segment(u64_t segment) {
+    if (_segments[segment].load(std::memory_order_acquire) != nullptr) {
+        return;
+    }
+
+    const u64_t capacity = segment_capacity(segment);
+    auto* seg = static_cast<slot*>(_resource->allocate(sizeof(slot) * capacity, alignof(slot)));
+    for (auto i = 0ull; i < capacity; ++i) {
+        std::construct_at(&seg[i]);
+    }
+
+    // lost the race, someone else published theirs
+    slot* expected = nullptr;
+    if (!_segments[segment].compare_exchange_strong(expected, seg, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        std::destroy_n(seg, capacity);
+        _resource->deallocate(seg, sizeof(slot) * capacity, alignof(slot));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include "dbg/log.hpp"
+
+#ifdef WIN32
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace dry {
+
+#ifdef WIN32
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    // TODO : NOTE : no unicode
+    const HANDLE file = CreateFileA(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERR("Could not open %s", path.string().c_str());
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        LOG_ERR("Could not map %s", path.string().c_str());
+        CloseHandle(file);
+        return;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        LOG_ERR("Could not map %s", path.string().c_str());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const std::byte*>(view);
+    _size = static_cast<u64_t>(size.QuadPart);
+}
+
+void mapped_file::unmap() noexcept {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _size = 0;
+    _file = nullptr;
+    _mapping = nullptr;
+}
+#else
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        LOG_ERR("Could not open %s", path.c_str());
+        return;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close(file);
+        return;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps its own reference to the file
+    close(file);
+    if (view == MAP_FAILED) {
+        LOG_ERR("Could not map %s", path.c_str());
+        return;
+    }
+
+    _data = static_cast<const std::byte*>(view);
+    _size = static_cast<u64_t>(info.st_size);
+}
+
+void mapped_file::unmap() noexcept {
+    if (_data != nullptr) {
+        munmap(const_cast<std::byte*>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+#endif
+
+mapped_file::mapped_file(mapped_file&& oth) noexcept {
+    *this = std::move(oth);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& oth) noexcept {
+    if (this != &oth) {
+        unmap();
+        _data = std::exchange(oth._data, nullptr);
+        _size = std::exchange(oth._size, 0);
+#ifdef WIN32
+        _file = std::exchange(oth._file, nullptr);
+        _mapping = std::exchange(oth._mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file() {
+    unmap();
+}
+
+}
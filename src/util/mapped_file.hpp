@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef DRY_UTIL_MAPPED_FILE_H
+#define DRY_UTIL_MAPPED_FILE_H
+
+#include <filesystem>
+
+#include "num.hpp"
+
+namespace dry {
+
+// read only view of a whole file through the os page cache, nothing is copied up front
+class mapped_file {
+public:
+    mapped_file() = default;
+    // empty() afterwards when the file can't be opened or mapped
+    explicit mapped_file(const std::filesystem::path& path);
+    mapped_file(mapped_file&& oth) noexcept;
+    mapped_file& operator=(mapped_file&& oth) noexcept;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file();
+
+    const std::byte* data() const noexcept { return _data; }
+    u64_t size() const noexcept { return _size; }
+    bool empty() const noexcept { return _data == nullptr; }
+    const_byte_span bytes() const noexcept { return { _data, _size }; }
+
+private:
+    void unmap() noexcept;
+
+    const std::byte* _data = nullptr;
+    u64_t _size = 0;
+#ifdef WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+};
+
+}
+
+#endif
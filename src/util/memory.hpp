@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef DRY_UTIL_MEMORY_H
+#define DRY_UTIL_MEMORY_H
+
+#include <memory_resource>
+
+#include "num.hpp"
+
+namespace dry {
+
+// size class pools, reuses freed blocks instead of returning them upstream
+using pool_resource = std::pmr::unsynchronized_pool_resource;
+using synchronized_pool_resource = std::pmr::synchronized_pool_resource;
+
+// bump allocator for things sharing a lifetime (a level, a scene)
+// deallocate is a no-op, release() drops everything at once
+class arena_resource final : public std::pmr::monotonic_buffer_resource {
+public:
+    static constexpr u64_t default_initial_size = 1 << 20;
+
+    explicit arena_resource(u64_t initial_size = default_initial_size, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) :
+        std::pmr::monotonic_buffer_resource(initial_size, upstream)
+    {}
+
+    void release() {
+        std::pmr::monotonic_buffer_resource::release();
+        _bytes_allocated = 0;
+    }
+    // requested bytes since the last release
+    u64_t bytes_allocated() const noexcept {
+        return _bytes_allocated;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        _bytes_allocated += bytes;
+        return std::pmr::monotonic_buffer_resource::do_allocate(bytes, alignment);
+    }
+
+private:
+    u64_t _bytes_allocated = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,468 @@
+#pragma once
+
+#ifndef DRY_UTIL_PAGED_SPARSE_ARRAY_H
+#define DRY_UTIL_PAGED_SPARSE_ARRAY_H
+
+#include <limits>
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include <span>
+#include <memory_resource>
+
+#include "num.hpp"
+#include "bitmap.hpp"
+
+namespace dry {
+
+template<typename, u64_t>
+class paged_sparse_array_iterator;
+
+// sparse_array over fixed size pages allocated on demand
+// growing never relocates, element addresses stay valid until the element is removed
+template<typename T, u64_t PageBytes = 16384>
+class paged_sparse_array {
+public:
+    using iterator = paged_sparse_array_iterator<T, PageBytes>;
+    using const_iterator = paged_sparse_array_iterator<const T, PageBytes>;
+
+    using index_t = u64_t;
+    static constexpr index_t index_null = (std::numeric_limits<index_t>::max)();
+    static constexpr u64_t page_capacity = sizeof(T) >= PageBytes ? 1 : PageBytes / sizeof(T);
+
+    paged_sparse_array(u64_t capacity = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // NOTE : copies use the default resource, same as pmr containers
+    paged_sparse_array(const paged_sparse_array&);
+    paged_sparse_array(paged_sparse_array&&) noexcept;
+    ~paged_sparse_array();
+
+    void reserve(u64_t capacity);
+    void clear();
+    u64_t size() const;
+    u64_t capacity() const;
+    std::pmr::memory_resource* resource() const noexcept;
+
+    template<typename... Args>
+    index_t emplace(Args&&... args);
+    void remove(index_t index);
+
+    bool contains(index_t index) const noexcept;
+
+    // moves live elements down to [0, size) keeping their order and frees the pages past it
+    // returns an old -> new index map, index_null for slots that were empty
+    // NOTE : the one operation that moves elements, addresses of moved ones change
+    std::vector<index_t> compact();
+
+    // calls fun(std::span) or fun(first_index, std::span) for every contiguous run of live elements, in index order
+    // runs never cross a page boundary
+    template<typename Fun>
+    void for_each_run(Fun fun);
+    template<typename Fun>
+    void for_each_run(Fun fun) const;
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    const T& operator[](index_t index) const noexcept;
+    T& operator[](index_t index) noexcept;
+
+    paged_sparse_array& operator=(const paged_sparse_array&);
+    paged_sparse_array& operator=(paged_sparse_array&&) noexcept;
+
+private:
+    friend class paged_sparse_array_iterator<T, PageBytes>;
+    friend class paged_sparse_array_iterator<const T, PageBytes>;
+
+    T* allocate_page();
+    void deallocate_page(T* page);
+    void release_pages();
+
+    template<typename Fun>
+    void for_each_run_impl(Fun fun) const;
+
+    std::pmr::memory_resource* _resource;
+    std::pmr::vector<T*> _pages;
+    bitmap _occupancy;
+    std::pmr::vector<index_t> _free_stack;
+    u64_t _size = 0;
+    // one past the highest slot ever used
+    index_t _head = 0;
+};
+
+template<typename T, u64_t PageBytes>
+class paged_sparse_array_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::remove_const_t<T>;
+    using pointer = T*;
+    using reference = T&;
+
+    using index_t = typename paged_sparse_array<value_type, PageBytes>::index_t;
+
+    paged_sparse_array_iterator() noexcept = default;
+
+    index_t index() const noexcept { return _index; }
+
+    reference operator*() const noexcept { return (*_container)[_index]; }
+    pointer operator->() const noexcept { return &(*_container)[_index]; }
+
+    paged_sparse_array_iterator& operator++() noexcept {
+        _index = _container->_occupancy.find_next(_index + 1, _container->_head);
+        return *this;
+    }
+    paged_sparse_array_iterator operator++(int) noexcept {
+        auto ret = *this;
+        ++(*this);
+        return ret;
+    }
+    paged_sparse_array_iterator& operator--() noexcept {
+        _index = _container->_occupancy.find_prev(_index - 1);
+        return *this;
+    }
+    paged_sparse_array_iterator operator--(int) noexcept {
+        auto ret = *this;
+        --(*this);
+        return ret;
+    }
+
+    bool operator==(const paged_sparse_array_iterator& oth) const noexcept {
+        return _container == oth._container && _index == oth._index;
+    }
+    bool operator!=(const paged_sparse_array_iterator& oth) const noexcept {
+        return !(*this == oth);
+    }
+
+private:
+    friend class paged_sparse_array<value_type, PageBytes>;
+
+    using container_t = std::conditional_t<std::is_const_v<T>,
+        const paged_sparse_array<value_type, PageBytes>, paged_sparse_array<value_type, PageBytes>
+    >;
+
+    paged_sparse_array_iterator(container_t& container, index_t index) noexcept :
+        _container{ &container },
+        _index{ index }
+    {}
+
+    container_t* _container = nullptr;
+    index_t _index = paged_sparse_array<value_type, PageBytes>::index_null;
+};
+
+
+
+// impl
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::paged_sparse_array(u64_t capacity, std::pmr::memory_resource* resource) :
+    _resource{ resource },
+    _pages{ resource },
+    _occupancy{ 0, resource },
+    _free_stack{ resource }
+{
+    reserve(capacity);
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::paged_sparse_array(const paged_sparse_array& oth) :
+    paged_sparse_array(0)
+{
+    *this = oth;
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::paged_sparse_array(paged_sparse_array&& oth) noexcept :
+    paged_sparse_array(0, oth._resource)
+{
+    *this = std::move(oth);
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::~paged_sparse_array() {
+    release_pages();
+}
+
+template<typename T, u64_t PageBytes>
+void paged_sparse_array<T, PageBytes>::reserve(u64_t capacity) {
+    const u64_t page_count = (capacity + page_capacity - 1) / page_capacity;
+    if (page_count <= _pages.size()) {
+        return;
+    }
+
+    _pages.reserve(page_count);
+    while (_pages.size() < page_count) {
+        _pages.push_back(allocate_page());
+    }
+    _occupancy.resize(page_count * page_capacity);
+}
+
+template<typename T, u64_t PageBytes>
+void paged_sparse_array<T, PageBytes>::clear() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (auto& el : *this) {
+            el.~T();
+        }
+    }
+    _occupancy.clear();
+    _free_stack.clear();
+    _size = 0;
+    _head = 0;
+}
+
+template<typename T, u64_t PageBytes>
+u64_t paged_sparse_array<T, PageBytes>::size() const {
+    return _size;
+}
+
+template<typename T, u64_t PageBytes>
+u64_t paged_sparse_array<T, PageBytes>::capacity() const {
+    return _pages.size() * page_capacity;
+}
+
+template<typename T, u64_t PageBytes>
+std::pmr::memory_resource* paged_sparse_array<T, PageBytes>::resource() const noexcept {
+    return _resource;
+}
+
+template<typename T, u64_t PageBytes>
+template<typename... Args>
+paged_sparse_array<T, PageBytes>::index_t paged_sparse_array<T, PageBytes>::emplace(Args&&... args) {
+    index_t ret_pos = index_null;
+
+    if (_free_stack.size() != 0) {
+        ret_pos = _free_stack.back();
+        std::construct_at(&(*this)[ret_pos], std::forward<Args>(args)...);
+        _free_stack.pop_back();
+    } else {
+        // NOTE : one page at a time, nothing is moved
+        if (_head >= capacity()) {
+            reserve(capacity() + page_capacity);
+        }
+        std::construct_at(&(*this)[_head], std::forward<Args>(args)...);
+
+        ret_pos = _head;
+        _head += 1;
+    }
+    _occupancy.set(ret_pos);
+    _size += 1;
+
+    return ret_pos;
+}
+
+template<typename T, u64_t PageBytes>
+void paged_sparse_array<T, PageBytes>::remove(index_t index) {
+    (*this)[index].~T();
+
+    _occupancy.reset(index);
+    _free_stack.push_back(index);
+    _size -= 1;
+}
+
+template<typename T, u64_t PageBytes>
+bool paged_sparse_array<T, PageBytes>::contains(index_t index) const noexcept {
+    return index < _head && _occupancy.test(index);
+}
+
+template<typename T, u64_t PageBytes>
+std::vector<typename paged_sparse_array<T, PageBytes>::index_t> paged_sparse_array<T, PageBytes>::compact() {
+    std::vector<index_t> remap(_head, index_null);
+
+    // in place, a live element only ever moves down onto a slot that is empty or already moved out of
+    index_t new_ind = 0;
+    _occupancy.for_each_run(_head, [this, &new_ind, &remap](index_t first, index_t last) {
+        for (auto i = first; i < last; ++i, ++new_ind) {
+            if (i != new_ind) {
+                std::construct_at(&(*this)[new_ind], std::move((*this)[i]));
+                (*this)[i].~T();
+            }
+            remap[i] = new_ind;
+        }
+    });
+
+    const u64_t page_count = (_size + page_capacity - 1) / page_capacity;
+    while (_pages.size() > page_count) {
+        deallocate_page(_pages.back());
+        _pages.pop_back();
+    }
+    _pages.shrink_to_fit();
+
+    _occupancy.resize(0);
+    _occupancy.resize(capacity());
+    _occupancy.set_range(0, _size);
+    _free_stack.clear();
+    _free_stack.shrink_to_fit();
+    _head = _size;
+
+    return remap;
+}
+
+template<typename T, u64_t PageBytes>
+template<typename Fun>
+void paged_sparse_array<T, PageBytes>::for_each_run(Fun fun) {
+    for_each_run_impl([this, &fun](index_t first, index_t last) {
+        T* page = _pages[first / page_capacity];
+        if constexpr (std::is_invocable_v<Fun&, index_t, std::span<T>>) {
+            fun(first, std::span<T>{ page + first % page_capacity, last - first });
+        } else {
+            fun(std::span<T>{ page + first % page_capacity, last - first });
+        }
+    });
+}
+
+template<typename T, u64_t PageBytes>
+template<typename Fun>
+void paged_sparse_array<T, PageBytes>::for_each_run(Fun fun) const {
+    for_each_run_impl([this, &fun](index_t first, index_t last) {
+        const T* page = _pages[first / page_capacity];
+        if constexpr (std::is_invocable_v<Fun&, index_t, std::span<const T>>) {
+            fun(first, std::span<const T>{ page + first % page_capacity, last - first });
+        } else {
+            fun(std::span<const T>{ page + first % page_capacity, last - first });
+        }
+    });
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::iterator paged_sparse_array<T, PageBytes>::begin() {
+    return iterator{ *this, _occupancy.find_next(0, _head) };
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::const_iterator paged_sparse_array<T, PageBytes>::begin() const {
+    return cbegin();
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::const_iterator paged_sparse_array<T, PageBytes>::cbegin() const {
+    return const_iterator{ *this, _occupancy.find_next(0, _head) };
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::iterator paged_sparse_array<T, PageBytes>::end() {
+    return iterator{ *this, _head };
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::const_iterator paged_sparse_array<T, PageBytes>::end() const {
+    return cend();
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>::const_iterator paged_sparse_array<T, PageBytes>::cend() const {
+    return const_iterator{ *this, _head };
+}
+
+template<typename T, u64_t PageBytes>
+const T& paged_sparse_array<T, PageBytes>::operator[](index_t index) const noexcept {
+    return _pages[index / page_capacity][index % page_capacity];
+}
+
+template<typename T, u64_t PageBytes>
+T& paged_sparse_array<T, PageBytes>::operator[](index_t index) noexcept {
+    return _pages[index / page_capacity][index % page_capacity];
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>& paged_sparse_array<T, PageBytes>::operator=(const paged_sparse_array& oth) {
+    if (&oth == this) {
+        return *this;
+    }
+
+    clear();
+    reserve(oth._head);
+
+    for (auto p = oth.begin(); p != oth.end(); ++p) {
+        std::construct_at(&(*this)[p.index()], *p);
+    }
+
+    _occupancy = oth._occupancy;
+    _occupancy.resize(capacity());
+    _free_stack = oth._free_stack;
+    _size = oth._size;
+    _head = oth._head;
+
+    return *this;
+}
+
+template<typename T, u64_t PageBytes>
+paged_sparse_array<T, PageBytes>& paged_sparse_array<T, PageBytes>::operator=(paged_sparse_array&& oth) noexcept {
+    if (&oth == this) {
+        return *this;
+    }
+    // different resources, pages can't change hands
+    if (*_resource != *oth._resource) {
+        clear();
+        reserve(oth._head);
+
+        for (auto p = oth.begin(); p != oth.end(); ++p) {
+            std::construct_at(&(*this)[p.index()], std::move(*p));
+        }
+
+        _occupancy = oth._occupancy;
+        _occupancy.resize(capacity());
+        _free_stack = oth._free_stack;
+        _size = oth._size;
+        _head = oth._head;
+
+        oth.clear();
+        return *this;
+    }
+
+    release_pages();
+
+    _pages = std::move(oth._pages);
+    _occupancy = std::move(oth._occupancy);
+    _free_stack = std::move(oth._free_stack);
+    _size = oth._size;
+    _head = oth._head;
+
+    oth._pages.clear();
+    oth._free_stack.clear();
+    oth._size = 0;
+    oth._head = 0;
+
+    return *this;
+}
+
+template<typename T, u64_t PageBytes>
+T* paged_sparse_array<T, PageBytes>::allocate_page() {
+    return static_cast<T*>(_resource->allocate(sizeof(T) * page_capacity, alignof(T)));
+}
+
+template<typename T, u64_t PageBytes>
+void paged_sparse_array<T, PageBytes>::deallocate_page(T* page) {
+    _resource->deallocate(page, sizeof(T) * page_capacity, alignof(T));
+}
+
+template<typename T, u64_t PageBytes>
+void paged_sparse_array<T, PageBytes>::release_pages() {
+    if (_pages.size() == 0) {
+        return;
+    }
+
+    clear();
+    for (auto* page : _pages) {
+        deallocate_page(page);
+    }
+    _pages.clear();
+}
+
+template<typename T, u64_t PageBytes>
+template<typename Fun>
+void paged_sparse_array<T, PageBytes>::for_each_run_impl(Fun fun) const {
+    _occupancy.for_each_run(_head, [&fun](index_t first, index_t last) {
+        while (first != last) {
+            const index_t page_end = (std::min)(last, (first / page_capacity + 1) * page_capacity);
+            fun(first, page_end);
+            first = page_end;
+        }
+    });
+}
+
+}
+
+#endif
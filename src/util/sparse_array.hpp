@@ -7,16 +7,20 @@
 #include <type_traits>
 #include <memory>
 #include <vector>
-#include <functional>
-#include <algorithm>
+#include <memory_resource>
+#include <span>
+#include <cstring>
 
 #include "num.hpp"
+#include "bitmap.hpp"
 
 namespace dry {
 
 template<typename>
 class sparse_array_iterator;
 
+// occupancy is kept in a bitmap, freed slots go on a stack
+// emplace and remove are O(1), iteration skips empty slots a word at a time
 template<typename T>
 class sparse_array {
 public:
@@ -26,7 +30,8 @@ public:
     using index_t = u64_t;
     static constexpr index_t index_null = (std::numeric_limits<index_t>::max)();
 
-    sparse_array(u64_t capacity = 0);
+    sparse_array(u64_t capacity = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // NOTE : copies use the default resource, same as pmr containers
     sparse_array(const sparse_array&);
     sparse_array(sparse_array&&) noexcept;
     ~sparse_array();
@@ -34,11 +39,24 @@ public:
     void reserve(u64_t capacity);
     void clear();
     u64_t size() const;
+    std::pmr::memory_resource* resource() const noexcept;
 
     template<typename... Args>
     index_t emplace(Args&&... args);
     void remove(index_t index);
 
+    bool contains(index_t index) const noexcept;
+
+    // moves live elements down to [0, size) keeping their order and shrinks capacity to size
+    // returns an old -> new index map, index_null for slots that were empty
+    std::vector<index_t> compact();
+
+    // calls fun(std::span) for every contiguous run of live elements, in index order
+    template<typename Fun>
+    void for_each_run(Fun fun);
+    template<typename Fun>
+    void for_each_run(Fun fun) const;
+
     iterator begin();
     const_iterator begin() const;
     const_iterator cbegin() const;
@@ -60,20 +78,27 @@ public:
     sparse_array& operator=(sparse_array&&) noexcept;
 
 private:
-    friend class iterator;
-    friend class const_iterator;
-    // store head at front
-    std::vector<index_t> _available_queue;
-    T* _arr;
-    u64_t _capacity;
-    index_t _first;
+    friend class sparse_array_iterator<T>;
+    friend class sparse_array_iterator<const T>;
+
+    T* allocate(u64_t count);
+    void deallocate(T* arr, u64_t count);
+
+    std::pmr::memory_resource* _resource;
+    bitmap _occupancy;
+    std::pmr::vector<index_t> _free_stack;
+    T* _arr = nullptr;
+    u64_t _capacity = 0;
+    u64_t _size = 0;
+    // one past the highest slot ever used
+    index_t _head = 0;
 };
 
 template<typename T>
 class sparse_array_iterator {
 public:
     using iterator_category = std::bidirectional_iterator_tag;
-    using difference_type = void;
+    using difference_type = std::ptrdiff_t;
     using value_type = std::remove_const_t<T>;
     using pointer = T*;
     using reference = T&;
@@ -102,18 +127,10 @@ private:
     friend class sparse_array<value_type>;
 
     using container_t = std::conditional_t<std::is_const_v<T>, const sparse_array<value_type>, sparse_array<value_type>>;
-    using container_queue_t = decltype(sparse_array<value_type>::_available_queue);
-    using container_queue_it_t = std::reverse_iterator<
-        std::conditional_t<std::is_const_v<T>, typename container_queue_t::const_iterator, typename container_queue_t::iterator>
-    >;
-
-    static sparse_array_iterator begin_iterator(container_t& container);
-    static sparse_array_iterator end_iterator(container_t& container);
 
     sparse_array_iterator(container_t& container, index_t index) noexcept;
 
     container_t* _container = nullptr;
-    container_queue_it_t _queue_it = {};
     index_t _index = sparse_array<value_type>::index_null;
 };
 
@@ -137,11 +154,7 @@ sparse_array_iterator<T>::pointer sparse_array_iterator<T>::operator->() const n
 
 template<typename T>
 sparse_array_iterator<T>& sparse_array_iterator<T>::operator++() noexcept {
-    _index += 1;
-    while (_index == *_queue_it && _index != _container->_available_queue[0]) {
-        _index += 1;
-        ++_queue_it;
-    }
+    _index = _container->_occupancy.find_next(_index + 1, _container->_head);
     return *this;
 }
 
@@ -154,24 +167,21 @@ sparse_array_iterator<T> sparse_array_iterator<T>::operator++(int) noexcept {
 
 template<typename T>
 sparse_array_iterator<T>& sparse_array_iterator<T>::operator--() noexcept {
-    _index -= 1;
-    while (_index == *_queue_it && _index != _container->_first) {
-        _index -= 1;
-        --_queue_it;
-    }
+    // NOTE : decrementing begin is undefined, same as for any other container
+    _index = _container->_occupancy.find_prev(_index - 1);
     return *this;
 }
 
 template<typename T>
 sparse_array_iterator<T> sparse_array_iterator<T>::operator--(int) noexcept {
     auto ret = *this;
-    ++(*this);
+    --(*this);
     return ret;
 }
 
 template<typename T>
 bool operator==(const sparse_array_iterator<T>& l, const sparse_array_iterator<T>& r) {
-    return l._container == r._container && l._queue_it == r._queue_it && l._index == r._index;
+    return l._container == r._container && l._index == r._index;
 }
 
 template<typename T>
@@ -179,33 +189,9 @@ bool operator!=(const sparse_array_iterator<T>& l, const sparse_array_iterator<T
     return !(l == r);
 }
 
-template<typename T>
-sparse_array_iterator<T> sparse_array_iterator<T>::begin_iterator(container_t& container) {
-    sparse_array_iterator ret;
-    ret._container = &container;
-    ret._index = container._first;
-    ret._queue_it = container._available_queue.rbegin();
-
-    return ret;
-}
-
-template<typename T>
-sparse_array_iterator<T> sparse_array_iterator<T>::end_iterator(container_t& container) {
-    sparse_array_iterator ret;
-    ret._container = &container;
-    ret._index = container._available_queue[0];
-    ret._queue_it = container._available_queue.rend() - 1;
-
-    return ret;
-}
-
 template<typename T>
 sparse_array_iterator<T>::sparse_array_iterator(container_t& container, index_t index) noexcept :
     _container{ &container },
-    _queue_it{ std::upper_bound(
-        container._available_queue.rbegin(),
-        container._available_queue.rend(), index
-    ) },
     _index{ index }
 {
 }
@@ -213,22 +199,25 @@ sparse_array_iterator<T>::sparse_array_iterator(container_t& container, index_t
 
 
 template<typename T>
-sparse_array<T>::sparse_array(u64_t capacity) :
-    _available_queue(1, 0),
-    _arr{ nullptr },
-    _capacity{ 0 },
-    _first{ 0 }
+sparse_array<T>::sparse_array(u64_t capacity, std::pmr::memory_resource* resource) :
+    _resource{ resource },
+    _occupancy{ 0, resource },
+    _free_stack{ resource }
 {
     reserve(capacity);
 }
 
 template<typename T>
-sparse_array<T>::sparse_array(const sparse_array& oth) {
+sparse_array<T>::sparse_array(const sparse_array& oth) :
+    sparse_array(0)
+{
     *this = oth;
 }
 
 template<typename T>
-sparse_array<T>::sparse_array(sparse_array&& oth) noexcept {
+sparse_array<T>::sparse_array(sparse_array&& oth) noexcept :
+    sparse_array(0, oth._resource)
+{
     *this = std::move(oth);
 }
 
@@ -236,7 +225,7 @@ template<typename T>
 sparse_array<T>::~sparse_array() {
     if (_arr != nullptr) {
         clear();
-        ::operator delete(static_cast<void*>(_arr));
+        deallocate(_arr, _capacity);
     }
 }
 
@@ -246,10 +235,10 @@ void sparse_array<T>::reserve(u64_t capacity) {
         return;
     }
 
-    T* new_arr = static_cast<T*>(::operator new(sizeof(T) * capacity));
+    T* new_arr = allocate(capacity);
     if (_arr != nullptr) {
         if constexpr (std::is_trivially_copyable_v<T>) {
-            std::copy(_arr, _arr + _available_queue[0], new_arr);
+            std::memcpy(static_cast<void*>(new_arr), static_cast<const void*>(_arr), sizeof(T) * _head);
         }
         else {
             for (auto p = begin(); p != end(); ++p) {
@@ -257,10 +246,11 @@ void sparse_array<T>::reserve(u64_t capacity) {
                 _arr[p.index()].~T();
             }
         }
-        ::operator delete(static_cast<void*>(_arr));
+        deallocate(_arr, _capacity);
     }
     _arr = new_arr;
     _capacity = capacity;
+    _occupancy.resize(capacity);
 }
 
 template<typename T>
@@ -269,15 +259,21 @@ void sparse_array<T>::clear() {
         for (auto& el : *this) {
             el.~T();
         }
-
-        _available_queue.resize(1, 0);
-        _first = 0;
     }
+    _occupancy.clear();
+    _free_stack.clear();
+    _size = 0;
+    _head = 0;
 }
 
 template<typename T>
 u64_t sparse_array<T>::size() const {
-    return _available_queue[0] - _available_queue.size() + 1;
+    return _size;
+}
+
+template<typename T>
+std::pmr::memory_resource* sparse_array<T>::resource() const noexcept {
+    return _resource;
 }
 
 template<typename T>
@@ -285,24 +281,23 @@ template<typename... Args>
 sparse_array<T>::index_t sparse_array<T>::emplace(Args&&... args) {
     index_t ret_pos = index_null;
 
-    if (_available_queue.size() != 1) {
-        ret_pos = _available_queue.back();
-        _available_queue.pop_back();
+    if (_free_stack.size() != 0) {
+        ret_pos = _free_stack.back();
         std::construct_at(&_arr[ret_pos], std::forward<Args>(args)...);
-
-        if (ret_pos < _first) {
-            _first = ret_pos;
-        }
+        _free_stack.pop_back();
     }
     else {
-        if (_available_queue[0] >= _capacity) {
+        if (_head >= _capacity) {
             reserve(_capacity == 0 ? 1 : 2 * _capacity);
         }
-        std::construct_at(&_arr[_available_queue[0]], std::forward<Args>(args)...);
+        std::construct_at(&_arr[_head], std::forward<Args>(args)...);
 
-        ret_pos = _available_queue[0];
-        _available_queue[0] += 1;
+        ret_pos = _head;
+        _head += 1;
     }
+    _occupancy.set(ret_pos);
+    _size += 1;
+
     return ret_pos;
 }
 
@@ -310,23 +305,72 @@ template<typename T>
 void sparse_array<T>::remove(index_t index) {
     _arr[index].~T();
 
-    auto it = std::upper_bound(_available_queue.begin() + 1, _available_queue.end(), index, std::greater<index_t>{});
-    auto new_it = _available_queue.emplace(it, index);
+    _occupancy.reset(index);
+    _free_stack.push_back(index);
+    _size -= 1;
+}
+
+template<typename T>
+bool sparse_array<T>::contains(index_t index) const noexcept {
+    return index < _head && _occupancy.test(index);
+}
+
+template<typename T>
+std::vector<typename sparse_array<T>::index_t> sparse_array<T>::compact() {
+    std::vector<index_t> remap(_head, index_null);
+
+    T* new_arr = _size == 0 ? nullptr : allocate(_size);
+    index_t new_ind = 0;
 
-    if (index == _first) {
-        for (; new_it != _available_queue.begin(); --new_it) {
-            if ((*(new_it - 1) - *new_it) != 1) {
-                _first = *new_it + 1;
-                return;
+    _occupancy.for_each_run(_head, [this, new_arr, &new_ind, &remap](index_t first, index_t last) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            std::memcpy(static_cast<void*>(new_arr + new_ind), static_cast<const void*>(_arr + first), sizeof(T) * (last - first));
+        }
+        for (auto i = first; i < last; ++i, ++new_ind) {
+            if constexpr (!std::is_trivially_copyable_v<T>) {
+                std::construct_at(&new_arr[new_ind], std::move(_arr[i]));
+                _arr[i].~T();
             }
+            remap[i] = new_ind;
         }
-        _first = _available_queue[0];
+    });
+
+    if (_arr != nullptr) {
+        deallocate(_arr, _capacity);
     }
+    _arr = new_arr;
+    _capacity = _size;
+    _head = _size;
+
+    _occupancy = bitmap{ _size, _resource };
+    for (auto i = 0ull; i < _size; ++i) {
+        _occupancy.set(i);
+    }
+    _free_stack.clear();
+    _free_stack.shrink_to_fit();
+
+    return remap;
+}
+
+template<typename T>
+template<typename Fun>
+void sparse_array<T>::for_each_run(Fun fun) {
+    _occupancy.for_each_run(_head, [this, &fun](index_t first, index_t last) {
+        fun(std::span<T>{ _arr + first, _arr + last });
+    });
+}
+
+template<typename T>
+template<typename Fun>
+void sparse_array<T>::for_each_run(Fun fun) const {
+    _occupancy.for_each_run(_head, [this, &fun](index_t first, index_t last) {
+        fun(std::span<const T>{ _arr + first, _arr + last });
+    });
 }
 
 template<typename T>
 sparse_array<T>::iterator sparse_array<T>::begin() {
-    return iterator::begin_iterator(*this);
+    return iterator{ *this, _occupancy.find_next(0, _head) };
 }
 
 template<typename T>
@@ -336,12 +380,12 @@ sparse_array<T>::const_iterator sparse_array<T>::begin() const {
 
 template<typename T>
 sparse_array<T>::const_iterator sparse_array<T>::cbegin() const {
-    return const_iterator::begin_iterator(*this);
+    return const_iterator{ *this, _occupancy.find_next(0, _head) };
 }
 
 template<typename T>
 std::reverse_iterator<typename sparse_array<T>::iterator> sparse_array<T>::rbegin() {
-    return std::reverse_iterator<iterator>{ begin() };
+    return std::reverse_iterator<iterator>{ end() };
 }
 
 template<typename T>
@@ -351,12 +395,12 @@ std::reverse_iterator<typename sparse_array<T>::const_iterator> sparse_array<T>:
 
 template<typename T>
 std::reverse_iterator<typename sparse_array<T>::const_iterator> sparse_array<T>::crbegin() const {
-    return std::reverse_iterator<const_iterator>{ cbegin() };
+    return std::reverse_iterator<const_iterator>{ cend() };
 }
 
 template<typename T>
 sparse_array<T>::iterator sparse_array<T>::end() {
-    return iterator::end_iterator(*this);
+    return iterator{ *this, _head };
 }
 
 template<typename T>
@@ -366,12 +410,12 @@ sparse_array<T>::const_iterator sparse_array<T>::end() const {
 
 template<typename T>
 sparse_array<T>::const_iterator sparse_array<T>::cend() const {
-    return const_iterator::end_iterator(*this);
+    return const_iterator{ *this, _head };
 }
 
 template<typename T>
 std::reverse_iterator<typename sparse_array<T>::iterator> sparse_array<T>::rend() {
-    return std::reverse_iterator<iterator>{ end() };
+    return std::reverse_iterator<iterator>{ begin() };
 }
 
 template<typename T>
@@ -381,7 +425,7 @@ std::reverse_iterator<typename sparse_array<T>::const_iterator> sparse_array<T>:
 
 template<typename T>
 std::reverse_iterator<typename sparse_array<T>::const_iterator> sparse_array<T>::crend() const {
-    return std::reverse_iterator<const_iterator>{ cend() };
+    return std::reverse_iterator<const_iterator>{ cbegin() };
 }
 
 template<typename T>
@@ -401,33 +445,77 @@ sparse_array<T>& sparse_array<T>::operator=(const sparse_array& oth) {
     }
 
     clear();
-
-    _available_queue = oth._available_queue;
-    _first = oth._first;
-
-    reserve(oth._available_queue[0]);
+    reserve(oth._head);
 
     for (auto p = oth.begin(); p != oth.end(); ++p) {
-        std::construct_at(&_arr[p.index()], std::move(*p));
+        std::construct_at(&_arr[p.index()], *p);
     }
+
+    _occupancy = oth._occupancy;
+    _occupancy.resize(_capacity);
+    _free_stack = oth._free_stack;
+    _size = oth._size;
+    _head = oth._head;
+
     return *this;
 }
 
 template<typename T>
 sparse_array<T>& sparse_array<T>::operator=(sparse_array&& oth) noexcept {
-    clear();
+    if (&oth == this) {
+        return *this;
+    }
+    // different resources, can't steal the storage
+    if (*_resource != *oth._resource) {
+        clear();
+        reserve(oth._head);
 
-    _available_queue = std::move(oth._available_queue);
-    _first = oth._first;
-    _capacity = oth._capacity;
+        for (auto p = oth.begin(); p != oth.end(); ++p) {
+            std::construct_at(&_arr[p.index()], std::move(*p));
+        }
+
+        _occupancy = oth._occupancy;
+        _occupancy.resize(_capacity);
+        _free_stack = oth._free_stack;
+        _size = oth._size;
+        _head = oth._head;
+
+        oth.clear();
+        return *this;
+    }
+
+    if (_arr != nullptr) {
+        clear();
+        deallocate(_arr, _capacity);
+    }
+
+    _occupancy = std::move(oth._occupancy);
+    _free_stack = std::move(oth._free_stack);
     _arr = oth._arr;
+    _capacity = oth._capacity;
+    _size = oth._size;
+    _head = oth._head;
 
+    oth._free_stack.clear();
     oth._arr = nullptr;
+    oth._capacity = 0;
+    oth._size = 0;
+    oth._head = 0;
 
     return *this;
 }
 
+template<typename T>
+T* sparse_array<T>::allocate(u64_t count) {
+    return static_cast<T*>(_resource->allocate(sizeof(T) * count, alignof(T)));
+}
+
+template<typename T>
+void sparse_array<T>::deallocate(T* arr, u64_t count) {
+    _resource->deallocate(arr, sizeof(T) * count, alignof(T));
+}
+
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -7,30 +7,48 @@
 #include <memory>
 #include <type_traits>
 #include <vector>
-#include <algorithm>
+#include <memory_resource>
+#include <cstring>
 
 #include "num.hpp"
+#include "bitmap.hpp"
 
 namespace dry {
 
+// free slots form an intrusive list, occupancy is mirrored in a bitmap for traversal
 template<typename T>
 class sparse_table {
 public:
     using index_t = u64_t;
     static constexpr index_t index_null = (std::numeric_limits<index_t>::max)();
 
-    sparse_table(u64_t capacity = 0);
+    sparse_table(u64_t capacity = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // NOTE : copies use the default resource, same as pmr containers
     sparse_table(const sparse_table&);
     sparse_table(sparse_table&&) noexcept;
     ~sparse_table();
 
     void reserve(u64_t capacity);
     void clear();
+    u64_t size() const;
+    std::pmr::memory_resource* resource() const noexcept;
 
     template<typename... Args>
     index_t emplace(Args&&... args);
     void remove(index_t index);
 
+    bool contains(index_t index) const noexcept;
+
+    // moves live elements down to [0, size) keeping their order and shrinks capacity to size
+    // returns an old -> new index map, index_null for slots that were empty
+    std::vector<index_t> compact();
+
+    // calls fun(index, value) or fun(value) for every live element in index order
+    template<typename Fun>
+    void for_each(Fun fun);
+    template<typename Fun>
+    void for_each(Fun fun) const;
+
     const T& operator[](index_t index) const noexcept;
     T& operator[](index_t index) noexcept;
 
@@ -46,34 +64,45 @@ private:
         index_t available;
     };
 
-    static void apply_to_range(auto* self, auto fun);
-
-    union_t* _arr;
-    index_t _head;
-    index_t _available;
-    u64_t _capacity;
+    // O(head / 64 + size), no allocations
+    template<typename Fun>
+    void apply_to_range(Fun fun) const;
+
+    union_t* allocate(u64_t count);
+    void deallocate(union_t* arr, u64_t count);
+    void move_from(sparse_table& oth);
+
+    std::pmr::memory_resource* _resource;
+    union_t* _arr = nullptr;
+    bitmap _occupancy;
+    index_t _head = 0;
+    index_t _available = index_null;
+    u64_t _capacity = 0;
+    u64_t _size = 0;
 };
 
 
 
 // impl
 template<typename T>
-sparse_table<T>::sparse_table(u64_t capacity) :
-    _arr{ nullptr },
-    _head{ 0 },
-    _available{ index_null },
-    _capacity{ 0 }
+sparse_table<T>::sparse_table(u64_t capacity, std::pmr::memory_resource* resource) :
+    _resource{ resource },
+    _occupancy{ 0, resource }
 {
     reserve(capacity);
 }
 
 template<typename T>
-sparse_table<T>::sparse_table(const sparse_table& oth) {
+sparse_table<T>::sparse_table(const sparse_table& oth) :
+    sparse_table(0)
+{
     *this = oth;
 }
 
 template<typename T>
-sparse_table<T>::sparse_table(sparse_table&& oth) noexcept {
+sparse_table<T>::sparse_table(sparse_table&& oth) noexcept :
+    sparse_table(0, oth._resource)
+{
     *this = std::move(oth);
 }
 
@@ -81,7 +110,7 @@ template<typename T>
 sparse_table<T>::~sparse_table() {
     if (_arr != nullptr) {
         clear();
-        ::operator delete(static_cast<void*>(_arr));
+        deallocate(_arr, _capacity);
     }
 }
 
@@ -91,25 +120,26 @@ void sparse_table<T>::reserve(u64_t capacity) {
         return;
     }
 
-    union_t* new_arr = static_cast<union_t*>(::operator new(sizeof(union_t) * capacity));
+    union_t* new_arr = allocate(capacity);
     if (_arr != nullptr) {
         if constexpr (std::is_trivially_copyable_v<T>) {
-            std::copy(_arr, _arr + _head, new_arr);
+            std::memcpy(static_cast<void*>(new_arr), static_cast<const void*>(_arr), sizeof(union_t) * _head);
         } else {
             auto move_l = [new_arr, this](index_t ind) {
                 std::construct_at(&new_arr[ind].value, std::move(_arr[ind].value));
                 _arr[ind].value.~T();
             };
-            apply_to_range(this, move_l);
+            apply_to_range(move_l);
 
             for (auto av_it = _available; av_it != index_null; av_it = _arr[av_it].available) {
                 new_arr[av_it].available = _arr[av_it].available;
             }
         }
-        ::operator delete(static_cast<void*>(_arr));
+        deallocate(_arr, _capacity);
     }
     _arr = new_arr;
     _capacity = capacity;
+    _occupancy.resize(capacity);
 }
 
 template<typename T>
@@ -117,11 +147,23 @@ void sparse_table<T>::clear() {
     if constexpr (!std::is_trivially_destructible_v<T>) {
         if (_arr != nullptr) {
             auto destroy_l = [this](index_t ind) { _arr[ind].value.~T(); };
-            apply_to_range(this, destroy_l);
+            apply_to_range(destroy_l);
         }
     }
+    _occupancy.clear();
     _head = 0;
     _available = index_null;
+    _size = 0;
+}
+
+template<typename T>
+u64_t sparse_table<T>::size() const {
+    return _size;
+}
+
+template<typename T>
+std::pmr::memory_resource* sparse_table<T>::resource() const noexcept {
+    return _resource;
 }
 
 template<typename T>
@@ -131,8 +173,9 @@ sparse_table<T>::index_t sparse_table<T>::emplace(Args&&... args) {
 
     if (_available != index_null) {
         ret_pos = _available;
-        _available = _arr[_available].available;
+        const index_t next_available = _arr[_available].available;
         std::construct_at(&_arr[ret_pos].value, std::forward<Args>(args)...);
+        _available = next_available;
     } else {
         if (_head >= _capacity) {
             reserve(_capacity == 0 ? 1 : 2 * _capacity);
@@ -142,6 +185,9 @@ sparse_table<T>::index_t sparse_table<T>::emplace(Args&&... args) {
         ret_pos = _head;
         _head += 1;
     }
+    _occupancy.set(ret_pos);
+    _size += 1;
+
     return ret_pos;
 }
 
@@ -151,6 +197,70 @@ void sparse_table<T>::remove(index_t index) {
     _arr[index].available = _available;
 
     _available = index;
+    _occupancy.reset(index);
+    _size -= 1;
+}
+
+template<typename T>
+bool sparse_table<T>::contains(index_t index) const noexcept {
+    return index < _head && _occupancy.test(index);
+}
+
+template<typename T>
+std::vector<typename sparse_table<T>::index_t> sparse_table<T>::compact() {
+    std::vector<index_t> remap(_head, index_null);
+
+    union_t* new_arr = _size == 0 ? nullptr : allocate(_size);
+    index_t new_head = 0;
+
+    apply_to_range([this, new_arr, &remap, &new_head](index_t ind) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            new_arr[new_head] = _arr[ind];
+        } else {
+            std::construct_at(&new_arr[new_head].value, std::move(_arr[ind].value));
+            _arr[ind].value.~T();
+        }
+        remap[ind] = new_head++;
+    });
+
+    if (_arr != nullptr) {
+        deallocate(_arr, _capacity);
+    }
+    _arr = new_arr;
+    _head = new_head;
+    _available = index_null;
+    _capacity = new_head;
+
+    _occupancy = bitmap{ new_head, _resource };
+    for (auto i = 0ull; i < new_head; ++i) {
+        _occupancy.set(i);
+    }
+
+    return remap;
+}
+
+template<typename T>
+template<typename Fun>
+void sparse_table<T>::for_each(Fun fun) {
+    apply_to_range([this, &fun](index_t ind) {
+        if constexpr (std::is_invocable_v<Fun, index_t, T&>) {
+            fun(ind, _arr[ind].value);
+        } else {
+            fun(_arr[ind].value);
+        }
+    });
+}
+
+template<typename T>
+template<typename Fun>
+void sparse_table<T>::for_each(Fun fun) const {
+    apply_to_range([this, &fun](index_t ind) {
+        if constexpr (std::is_invocable_v<Fun, index_t, const T&>) {
+            fun(ind, _arr[ind].value);
+        } else {
+            fun(_arr[ind].value);
+        }
+    });
 }
 
 template<typename T>
@@ -173,58 +283,102 @@ sparse_table<T>& sparse_table<T>::operator=(const sparse_table& oth) {
     reserve(oth._head);
 
     if constexpr (std::is_trivially_copyable_v<T>) {
-        std::copy(oth._arr, oth._head, _arr);
-    }
-    else {
+        std::memcpy(static_cast<void*>(_arr), static_cast<const void*>(oth._arr), sizeof(union_t) * oth._head);
+    } else {
         auto copy_l = [this, &oth](index_t ind) { std::construct_at(&_arr[ind].value, oth[ind]); };
-        apply_to_range(&oth, copy_l);
+        oth.apply_to_range(copy_l);
 
-        for (auto av = oth._available; av != index_null; av = oth._arr[av]) {
-            _arr[av] = oth._arr[av];
+        for (auto av = oth._available; av != index_null; av = oth._arr[av].available) {
+            _arr[av].available = oth._arr[av].available;
         }
     }
 
+    _occupancy = oth._occupancy;
+    _occupancy.resize(_capacity);
     _head = oth._head;
     _available = oth._available;
+    _size = oth._size;
 
     return *this;
 }
 
 template<typename T>
 sparse_table<T>& sparse_table<T>::operator=(sparse_table&& oth) noexcept {
-    clear();
+    if (&oth == this) {
+        return *this;
+    }
+    // different resources, can't steal the storage
+    if (*_resource != *oth._resource) {
+        move_from(oth);
+        return *this;
+    }
+
+    if (_arr != nullptr) {
+        clear();
+        deallocate(_arr, _capacity);
+    }
 
     _arr = oth._arr;
+    _occupancy = std::move(oth._occupancy);
     _head = oth._head;
     _available = oth._available;
     _capacity = oth._capacity;
+    _size = oth._size;
 
     oth._arr = nullptr;
+    oth._head = 0;
+    oth._available = index_null;
+    oth._capacity = 0;
+    oth._size = 0;
 
     return *this;
 }
 
 template<typename T>
-void sparse_table<T>::apply_to_range(auto* self, auto fun) {
-    std::vector<index_t> av_arr;
-    av_arr.reserve(self->_head / 4); // a guess, 1/4 is empty
+sparse_table<T>::union_t* sparse_table<T>::allocate(u64_t count) {
+    return static_cast<union_t*>(_resource->allocate(sizeof(union_t) * count, alignof(union_t)));
+}
 
-    for (auto av_it = self->_available; av_it != index_null; av_it = self->_arr[av_it].available) {
-        av_arr.insert(std::lower_bound(av_arr.begin(), av_arr.end(), av_it), av_it);
-    }
+template<typename T>
+void sparse_table<T>::deallocate(union_t* arr, u64_t count) {
+    _resource->deallocate(arr, sizeof(union_t) * count, alignof(union_t));
+}
+
+template<typename T>
+void sparse_table<T>::move_from(sparse_table& oth) {
+    clear();
+    reserve(oth._head);
+
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memcpy(static_cast<void*>(_arr), static_cast<const void*>(oth._arr), sizeof(union_t) * oth._head);
+    } else {
+        auto move_l = [this, &oth](index_t ind) { std::construct_at(&_arr[ind].value, std::move(oth[ind])); };
+        oth.apply_to_range(move_l);
 
-    index_t arr_it = 0;
-    for (auto frag_end : av_arr) {
-        for (; arr_it < frag_end; ++arr_it) {
-            fun(arr_it);
+        for (auto av = oth._available; av != index_null; av = oth._arr[av].available) {
+            _arr[av].available = oth._arr[av].available;
         }
-        ++arr_it;
-    }
-    for (; arr_it < self->_head; ++arr_it) {
-        fun(arr_it);
     }
+
+    _occupancy = oth._occupancy;
+    _occupancy.resize(_capacity);
+    _head = oth._head;
+    _available = oth._available;
+    _size = oth._size;
+
+    oth.clear();
+}
+
+template<typename T>
+template<typename Fun>
+void sparse_table<T>::apply_to_range(Fun fun) const {
+    _occupancy.for_each_run(_head, [&fun](index_t first, index_t last) {
+        for (; first < last; ++first) {
+            fun(first);
+        }
+    });
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,237 @@
+#pragma once
+
+#ifndef DRY_UTIL_THREAD_POOL_H
+#define DRY_UTIL_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "num.hpp"
+
+namespace dry {
+
+// engine wide worker threads, every worker owns a deque, pops its own work from the back
+// and steals from the front of the others when it runs dry
+// the thread calling parallel_for works on the range too instead of blocking
+class thread_pool {
+public:
+    // workers besides the calling thread
+    explicit thread_pool(u32_t worker_count = default_worker_count());
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    ~thread_pool();
+
+    static thread_pool& global();
+    static u32_t default_worker_count() noexcept;
+
+    // threads that take part in a parallel_for, workers plus the caller
+    u32_t thread_count() const noexcept;
+
+    // fun(begin, end) over [0, count) split in chunks of at least min_chunk
+    // chunk bounds only depend on count, min_chunk and thread_count, never on timing
+    template<typename Fun>
+    void parallel_for(u64_t count, u64_t min_chunk, Fun&& fun);
+    // the chunk size parallel_for picks
+    u64_t chunk_size(u64_t count, u64_t min_chunk) const noexcept;
+
+    using task_fun = void(*)(void* ctx, u64_t begin, u64_t end);
+    // fun(ctx, begin, end) as a single task on the calling thread's queue, pending goes up now
+    // and down once it ran, a running task may spawn more against the same counter
+    void spawn(task_fun fun, void* ctx, u64_t begin, u64_t end, std::atomic<u64_t>& pending);
+    // runs queued tasks on the calling thread until pending drops to 0, never blocks a worker
+    void wait(std::atomic<u64_t>& pending);
+
+private:
+    struct task {
+        task_fun fun;
+        void* ctx;
+        u64_t begin;
+        u64_t end;
+        std::atomic<u64_t>* pending;
+    };
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    void push(u32_t queue, const task& tsk);
+    bool try_run_one(u32_t self);
+    void worker_loop(u32_t self);
+    // queue of the current thread, external threads share queue 0
+    u32_t current_queue() const noexcept;
+
+    // queue 0 is for outside threads, worker i owns queue i + 1
+    std::vector<std::unique_ptr<task_queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<u64_t> _queued{ 0 };
+    std::mutex _sleep_mutex;
+    std::condition_variable _wake;
+    bool _stop = false;
+
+    static inline thread_local const thread_pool* _tl_pool = nullptr;
+    static inline thread_local u32_t _tl_queue = 0;
+};
+
+
+
+// impl
+inline thread_pool::thread_pool(u32_t worker_count) {
+    _queues.reserve(worker_count + 1);
+    for (auto i = 0u; i < worker_count + 1; ++i) {
+        _queues.push_back(std::make_unique<task_queue>());
+    }
+    _workers.reserve(worker_count);
+    for (auto i = 0u; i < worker_count; ++i) {
+        _workers.emplace_back([this, i] { worker_loop(i + 1); });
+    }
+}
+
+inline thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock{ _sleep_mutex };
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+inline thread_pool& thread_pool::global() {
+    static thread_pool pool;
+    return pool;
+}
+
+inline u32_t thread_pool::default_worker_count() noexcept {
+    const u32_t hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+}
+
+inline u32_t thread_pool::thread_count() const noexcept {
+    return static_cast<u32_t>(_workers.size() + 1);
+}
+
+inline u64_t thread_pool::chunk_size(u64_t count, u64_t min_chunk) const noexcept {
+    // a few chunks per thread so stealing can even out uneven work
+    constexpr u64_t chunks_per_thread = 4;
+    const u64_t target_chunks = u64_t{ thread_count() } * chunks_per_thread;
+    return (std::max)((std::max)(min_chunk, u64_t{ 1 }), (count + target_chunks - 1) / target_chunks);
+}
+
+template<typename Fun>
+void thread_pool::parallel_for(u64_t count, u64_t min_chunk, Fun&& fun) {
+    if (count == 0) {
+        return;
+    }
+    const u64_t chunk = chunk_size(count, min_chunk);
+    const u64_t chunk_count = (count + chunk - 1) / chunk;
+    if (chunk_count == 1 || _workers.empty()) {
+        for (u64_t beg = 0; beg < count; beg += chunk) {
+            fun(beg, (std::min)(beg + chunk, count));
+        }
+        return;
+    }
+
+    using fun_t = std::remove_reference_t<Fun>;
+    std::atomic<u64_t> pending{ chunk_count };
+    const auto trampoline = [](void* ctx, u64_t beg, u64_t end) {
+        (*static_cast<fun_t*>(ctx))(beg, end);
+    };
+
+    // spread over all queues so workers start on their own deque
+    for (u64_t i = 0; i < chunk_count; ++i) {
+        const u64_t beg = i * chunk;
+        push(static_cast<u32_t>(i % _queues.size()), { trampoline, &fun, beg, (std::min)(beg + chunk, count), &pending });
+    }
+    wait(pending);
+}
+
+inline void thread_pool::spawn(task_fun fun, void* ctx, u64_t begin, u64_t end, std::atomic<u64_t>& pending) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    push(current_queue(), { fun, ctx, begin, end, &pending });
+}
+
+inline void thread_pool::wait(std::atomic<u64_t>& pending) {
+    const u32_t self = current_queue();
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (!try_run_one(self)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void thread_pool::push(u32_t queue, const task& tsk) {
+    {
+        std::lock_guard lock{ _queues[queue]->mutex };
+        _queues[queue]->tasks.push_back(tsk);
+    }
+    _queued.fetch_add(1, std::memory_order_release);
+    {
+        // empty critical section orders the increment against a worker about to sleep
+        std::lock_guard lock{ _sleep_mutex };
+    }
+    _wake.notify_one();
+}
+
+inline bool thread_pool::try_run_one(u32_t self) {
+    task tsk;
+    bool found = false;
+
+    {
+        auto& own = *_queues[self];
+        std::lock_guard lock{ own.mutex };
+        if (!own.tasks.empty()) {
+            tsk = own.tasks.back();
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (auto i = 1u; !found && i < _queues.size(); ++i) {
+        auto& victim = *_queues[(self + i) % _queues.size()];
+        std::lock_guard lock{ victim.mutex };
+        if (!victim.tasks.empty()) {
+            tsk = victim.tasks.front();
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    _queued.fetch_sub(1, std::memory_order_relaxed);
+    tsk.fun(tsk.ctx, tsk.begin, tsk.end);
+    tsk.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+inline void thread_pool::worker_loop(u32_t self) {
+    _tl_pool = this;
+    _tl_queue = self;
+
+    while (true) {
+        if (try_run_one(self)) {
+            continue;
+        }
+        std::unique_lock lock{ _sleep_mutex };
+        _wake.wait(lock, [this] { return _stop || _queued.load(std::memory_order_acquire) != 0; });
+        if (_stop) {
+            return;
+        }
+    }
+}
+
+inline u32_t thread_pool::current_queue() const noexcept {
+    return _tl_pool == this ? _tl_queue : 0;
+}
+
+}
+
+#endif
@@ -3,7 +3,22 @@
 #ifndef DRY_UTIL_TRANS_HASHMAP_H
 #define DRY_UTIL_TRANS_HASHMAP_H
 
-#include <unordered_set>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DRY_HASHMAP_SSE2
+  #include <emmintrin.h>
+#endif
+
+#include "num.hpp"
 
 namespace dry {
 
@@ -20,7 +35,7 @@ struct transparent_hasher {
         else {
             return static_cast<std::size_t>(std::invoke(Hasher, val));
         }
-        
+
     }
     constexpr size_t operator()(const Hashed& val) const {
         if constexpr (std::is_pointer_v<Hashed>) {
@@ -29,7 +44,7 @@ struct transparent_hasher {
         else {
             return static_cast<std::size_t>(val);
         }
-        
+
     }
 };
 
@@ -47,11 +62,625 @@ struct transparent_comparator {
     }
 };
 
-template<typename Main, typename Hashed, auto Hasher>
-using hashmap = std::unordered_set<Main,
-    transparent_hasher<Main, Hashed, Hasher>,
-    transparent_comparator<Main, Hashed, Hasher>
->;
+namespace hashmap_detail {
+
+using ctrl_t = i8_t;
+// full slots store the low 7 bits of the hash, the sign bit marks free ones
+constexpr ctrl_t ctrl_empty = -128;
+constexpr ctrl_t ctrl_deleted = -2;
+constexpr u64_t group_width = 16;
+
+// bitmasks over one 16 slot group of control bytes
+struct group {
+#ifdef DRY_HASHMAP_SSE2
+    explicit group(const ctrl_t* ctrl) noexcept :
+        _ctrl{ _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl)) }
+    {}
+
+    u32_t match(ctrl_t h2) const noexcept {
+        return static_cast<u32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), _ctrl)));
+    }
+    // empty or deleted
+    u32_t match_free() const noexcept {
+        return static_cast<u32_t>(_mm_movemask_epi8(_ctrl));
+    }
+
+    __m128i _ctrl;
+#else
+    explicit group(const ctrl_t* ctrl) noexcept {
+        std::memcpy(_ctrl, ctrl, group_width);
+    }
+
+    u32_t match(ctrl_t h2) const noexcept {
+        u32_t ret = 0;
+        for (auto i = 0u; i < group_width; ++i) {
+            ret |= static_cast<u32_t>(_ctrl[i] == h2) << i;
+        }
+        return ret;
+    }
+    u32_t match_free() const noexcept {
+        u32_t ret = 0;
+        for (auto i = 0u; i < group_width; ++i) {
+            ret |= static_cast<u32_t>(_ctrl[i] < 0) << i;
+        }
+        return ret;
+    }
+
+    ctrl_t _ctrl[group_width];
+#endif
+    u32_t match_empty() const noexcept {
+        return match(ctrl_empty);
+    }
+};
+
+// hashers are often identity, spread the bits before splitting into h1/h2
+constexpr u64_t mix(u64_t h) noexcept {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+template<typename, bool>
+class flat_hash_table_iterator;
+
+// open addressing table in swiss table fashion: 16 wide groups of 7 bit hash tags
+// probed with SSE2, values are stored inline so references are invalidated on rehash
+// Value is looked up by the key KeyOf projects out of it
+template<typename Value, typename Key, auto KeyOf, typename Hash = std::hash<Key>>
+class flat_hash_table {
+public:
+    using value_type = Value;
+    using key_type = Key;
+    using iterator = flat_hash_table_iterator<flat_hash_table, false>;
+    using const_iterator = flat_hash_table_iterator<flat_hash_table, true>;
+
+    explicit flat_hash_table(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept;
+    flat_hash_table(u64_t capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    flat_hash_table(const flat_hash_table&);
+    flat_hash_table(flat_hash_table&&) noexcept;
+    ~flat_hash_table();
+
+    u64_t size() const noexcept { return _size; }
+    bool empty() const noexcept { return _size == 0; }
+    u64_t capacity() const noexcept { return _capacity; }
+
+    void clear();
+    void reserve(u64_t count);
+
+    iterator begin() noexcept;
+    const_iterator begin() const noexcept;
+    iterator end() noexcept;
+    const_iterator end() const noexcept;
+
+    iterator find(const Key& key) noexcept;
+    const_iterator find(const Key& key) const noexcept;
+    iterator find(const Value& val) noexcept requires (!std::is_same_v<Value, Key>);
+    const_iterator find(const Value& val) const noexcept requires (!std::is_same_v<Value, Key>);
+
+    bool contains(const Key& key) const noexcept;
+    bool contains(const Value& val) const noexcept requires (!std::is_same_v<Value, Key>);
+    u64_t count(const Key& key) const noexcept { return contains(key) ? 1 : 0; }
+
+    std::pair<iterator, bool> insert(const Value& val);
+    std::pair<iterator, bool> insert(Value&& val);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+
+    void erase(const_iterator it);
+    u64_t erase(const Key& key);
+
+    flat_hash_table& operator=(const flat_hash_table&);
+    flat_hash_table& operator=(flat_hash_table&&) noexcept;
+
+protected:
+    static constexpr u64_t index_null = (std::numeric_limits<u64_t>::max)();
+
+    static const Key& key_of(const Value& val) noexcept {
+        return std::invoke(KeyOf, val);
+    }
+    static u64_t hash_of(const Key& key) noexcept {
+        return hashmap_detail::mix(static_cast<u64_t>(Hash{}(key)));
+    }
+
+    u64_t find_index(const Key& key, u64_t hash) const noexcept;
+    // claims a free slot for hash, the caller constructs the value in it
+    u64_t prepare_insert(u64_t hash);
+    u64_t find_free(u64_t hash) const noexcept;
+
+    void rehash(u64_t capacity);
+    void allocate(u64_t capacity);
+    void deallocate();
+    void destroy_slots();
+
+    iterator iterator_at(u64_t index) noexcept { return { _ctrl, _slots, index, _capacity }; }
+    const_iterator iterator_at(u64_t index) const noexcept { return { _ctrl, _slots, index, _capacity }; }
+
+    std::pmr::memory_resource* _resource;
+    hashmap_detail::ctrl_t* _ctrl = nullptr;
+    Value* _slots = nullptr;
+    u64_t _capacity = 0;
+    u64_t _size = 0;
+    // inserts left before a rehash, tombstones don't give it back
+    u64_t _growth_left = 0;
+
+private:
+    friend class flat_hash_table_iterator<flat_hash_table, false>;
+    friend class flat_hash_table_iterator<flat_hash_table, true>;
+
+    static constexpr u64_t max_load(u64_t capacity) noexcept { return capacity - capacity / 8; }
+    static constexpr u64_t alloc_alignment = (std::max)(hashmap_detail::group_width, alignof(Value));
+    static constexpr u64_t slot_offset(u64_t capacity) noexcept {
+        return (capacity + alignof(Value) - 1) / alignof(Value) * alignof(Value);
+    }
+};
+
+template<typename Table, bool Const>
+class flat_hash_table_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename Table::value_type;
+    using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+    using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+    flat_hash_table_iterator() noexcept = default;
+    // non const to const
+    template<bool OthConst> requires (Const && !OthConst)
+    flat_hash_table_iterator(const flat_hash_table_iterator<Table, OthConst>& oth) noexcept :
+        _ctrl{ oth._ctrl }, _slots{ oth._slots }, _index{ oth._index }, _capacity{ oth._capacity }
+    {}
+
+    reference operator*() const noexcept { return _slots[_index]; }
+    pointer operator->() const noexcept { return &_slots[_index]; }
+
+    flat_hash_table_iterator& operator++() noexcept {
+        skip_free(_index + 1);
+        return *this;
+    }
+    flat_hash_table_iterator operator++(int) noexcept {
+        auto ret = *this;
+        ++(*this);
+        return ret;
+    }
+
+    bool operator==(const flat_hash_table_iterator& oth) const noexcept { return _index == oth._index; }
+    bool operator!=(const flat_hash_table_iterator& oth) const noexcept { return _index != oth._index; }
+
+private:
+    friend Table;
+    friend class flat_hash_table_iterator<Table, true>;
+
+    using slot_ptr = std::conditional_t<Const, const value_type*, value_type*>;
+
+    flat_hash_table_iterator(const hashmap_detail::ctrl_t* ctrl, slot_ptr slots, u64_t index, u64_t capacity) noexcept :
+        _ctrl{ ctrl }, _slots{ slots }, _index{ index }, _capacity{ capacity }
+    {}
+
+    // moves to the first full slot at or after index, capacity if none
+    void skip_free(u64_t index) noexcept {
+        while (index < _capacity) {
+            const u64_t group_beg = index & ~(hashmap_detail::group_width - 1);
+            const u32_t full = ~hashmap_detail::group{ _ctrl + group_beg }.match_free() & 0xFFFF;
+            const u32_t masked = full >> (index - group_beg) << (index - group_beg);
+            if (masked != 0) {
+                _index = group_beg + std::countr_zero(masked);
+                return;
+            }
+            index = group_beg + hashmap_detail::group_width;
+        }
+        _index = _capacity;
+    }
+
+    const hashmap_detail::ctrl_t* _ctrl = nullptr;
+    slot_ptr _slots = nullptr;
+    u64_t _index = 0;
+    u64_t _capacity = 0;
+};
+
+// set of Main looked up by the Hashed value Hasher projects out of it
+template<typename Main, typename Hashed, auto Hasher> requires hash_invokable<Main, Hashed, Hasher>
+using hashmap = flat_hash_table<Main, Hashed, Hasher, transparent_hasher<Main, Hashed, Hasher>>;
+
+// key -> value map over the same table, values are not reference stable
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class flat_map : public flat_hash_table<std::pair<const Key, Value>, Key, &std::pair<const Key, Value>::first, Hash> {
+    using base = flat_hash_table<std::pair<const Key, Value>, Key, &std::pair<const Key, Value>::first, Hash>;
+
+public:
+    using mapped_type = Value;
+    using base::base;
+
+    template<typename... Args>
+    std::pair<typename base::iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        const u64_t hash = base::hash_of(key);
+        const u64_t found = base::find_index(key, hash);
+        if (found != base::index_null) {
+            return { base::iterator_at(found), false };
+        }
+
+        const u64_t index = base::prepare_insert(hash);
+        std::construct_at(&base::_slots[index], std::piecewise_construct,
+            std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...)
+        );
+        return { base::iterator_at(index), true };
+    }
+
+    Value& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+    // NOTE : no exceptions, key has to be present
+    Value& at(const Key& key) noexcept {
+        return base::find(key)->second;
+    }
+    const Value& at(const Key& key) const noexcept {
+        return base::find(key)->second;
+    }
+};
+
+
+
+// impl
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::flat_hash_table(std::pmr::memory_resource* resource) noexcept :
+    _resource{ resource }
+{
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::flat_hash_table(u64_t capacity, std::pmr::memory_resource* resource) :
+    _resource{ resource }
+{
+    reserve(capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::flat_hash_table(const flat_hash_table& oth) :
+    flat_hash_table()
+{
+    *this = oth;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::flat_hash_table(flat_hash_table&& oth) noexcept :
+    flat_hash_table(oth._resource)
+{
+    *this = std::move(oth);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::~flat_hash_table() {
+    destroy_slots();
+    deallocate();
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::clear() {
+    destroy_slots();
+    if (_capacity != 0) {
+        std::memset(_ctrl, hashmap_detail::ctrl_empty, _capacity);
+    }
+    _size = 0;
+    _growth_left = max_load(_capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::reserve(u64_t count) {
+    if (count <= _size + _growth_left) {
+        return;
+    }
+    u64_t capacity = (std::max)(_capacity, hashmap_detail::group_width);
+    while (max_load(capacity) < count) {
+        capacity *= 2;
+    }
+    rehash(capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::iterator flat_hash_table<Value, Key, KeyOf, Hash>::begin() noexcept {
+    iterator ret = iterator_at(0);
+    ret.skip_free(0);
+    return ret;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::const_iterator flat_hash_table<Value, Key, KeyOf, Hash>::begin() const noexcept {
+    const_iterator ret = iterator_at(0);
+    ret.skip_free(0);
+    return ret;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::iterator flat_hash_table<Value, Key, KeyOf, Hash>::end() noexcept {
+    return iterator_at(_capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::const_iterator flat_hash_table<Value, Key, KeyOf, Hash>::end() const noexcept {
+    return iterator_at(_capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::iterator flat_hash_table<Value, Key, KeyOf, Hash>::find(const Key& key) noexcept {
+    const u64_t index = find_index(key, hash_of(key));
+    return index == index_null ? end() : iterator_at(index);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::const_iterator flat_hash_table<Value, Key, KeyOf, Hash>::find(const Key& key) const noexcept {
+    const u64_t index = find_index(key, hash_of(key));
+    return index == index_null ? end() : iterator_at(index);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::iterator flat_hash_table<Value, Key, KeyOf, Hash>::find(const Value& val) noexcept
+    requires (!std::is_same_v<Value, Key>)
+{
+    return find(key_of(val));
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>::const_iterator flat_hash_table<Value, Key, KeyOf, Hash>::find(const Value& val) const noexcept
+    requires (!std::is_same_v<Value, Key>)
+{
+    return find(key_of(val));
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+bool flat_hash_table<Value, Key, KeyOf, Hash>::contains(const Key& key) const noexcept {
+    return find_index(key, hash_of(key)) != index_null;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+bool flat_hash_table<Value, Key, KeyOf, Hash>::contains(const Value& val) const noexcept
+    requires (!std::is_same_v<Value, Key>)
+{
+    return contains(key_of(val));
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+std::pair<typename flat_hash_table<Value, Key, KeyOf, Hash>::iterator, bool> flat_hash_table<Value, Key, KeyOf, Hash>::insert(const Value& val) {
+    const u64_t hash = hash_of(key_of(val));
+    const u64_t found = find_index(key_of(val), hash);
+    if (found != index_null) {
+        return { iterator_at(found), false };
+    }
+
+    const u64_t index = prepare_insert(hash);
+    std::construct_at(&_slots[index], val);
+    return { iterator_at(index), true };
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+std::pair<typename flat_hash_table<Value, Key, KeyOf, Hash>::iterator, bool> flat_hash_table<Value, Key, KeyOf, Hash>::insert(Value&& val) {
+    const u64_t hash = hash_of(key_of(val));
+    const u64_t found = find_index(key_of(val), hash);
+    if (found != index_null) {
+        return { iterator_at(found), false };
+    }
+
+    const u64_t index = prepare_insert(hash);
+    std::construct_at(&_slots[index], std::move(val));
+    return { iterator_at(index), true };
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+template<typename... Args>
+std::pair<typename flat_hash_table<Value, Key, KeyOf, Hash>::iterator, bool> flat_hash_table<Value, Key, KeyOf, Hash>::emplace(Args&&... args) {
+    // NOTE : key is only known after construction
+    return insert(Value(std::forward<Args>(args)...));
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::erase(const_iterator it) {
+    using namespace hashmap_detail;
+
+    const u64_t index = it._index;
+    std::destroy_at(&_slots[index]);
+
+    // a group that still has an empty slot never stopped a probe, safe to mark empty
+    const u64_t group_beg = index & ~(group_width - 1);
+    if (group{ _ctrl + group_beg }.match_empty() != 0) {
+        _ctrl[index] = ctrl_empty;
+        _growth_left += 1;
+    } else {
+        _ctrl[index] = ctrl_deleted;
+    }
+    _size -= 1;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+u64_t flat_hash_table<Value, Key, KeyOf, Hash>::erase(const Key& key) {
+    const u64_t index = find_index(key, hash_of(key));
+    if (index == index_null) {
+        return 0;
+    }
+    erase(iterator_at(index));
+    return 1;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>& flat_hash_table<Value, Key, KeyOf, Hash>::operator=(const flat_hash_table& oth) {
+    if (&oth == this) {
+        return *this;
+    }
+
+    destroy_slots();
+    deallocate();
+
+    if (oth._capacity != 0) {
+        allocate(oth._capacity);
+        std::memcpy(_ctrl, oth._ctrl, _capacity);
+        for (auto it = oth.begin(); it != oth.end(); ++it) {
+            std::construct_at(&_slots[it._index], *it);
+        }
+    }
+    _size = oth._size;
+    _growth_left = oth._growth_left;
+
+    return *this;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+flat_hash_table<Value, Key, KeyOf, Hash>& flat_hash_table<Value, Key, KeyOf, Hash>::operator=(flat_hash_table&& oth) noexcept {
+    if (&oth == this) {
+        return *this;
+    }
+    // different resources, can't steal the storage
+    if (*_resource != *oth._resource) {
+        clear();
+        reserve(oth._size);
+        for (auto& val : oth) {
+            insert(std::move(val));
+        }
+        oth.clear();
+        return *this;
+    }
+
+    destroy_slots();
+    deallocate();
+
+    _ctrl = oth._ctrl;
+    _slots = oth._slots;
+    _capacity = oth._capacity;
+    _size = oth._size;
+    _growth_left = oth._growth_left;
+
+    oth._ctrl = nullptr;
+    oth._slots = nullptr;
+    oth._capacity = 0;
+    oth._size = 0;
+    oth._growth_left = 0;
+
+    return *this;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+u64_t flat_hash_table<Value, Key, KeyOf, Hash>::find_index(const Key& key, u64_t hash) const noexcept {
+    using namespace hashmap_detail;
+
+    if (_capacity == 0) {
+        return index_null;
+    }
+
+    const ctrl_t h2 = static_cast<ctrl_t>(hash & 0x7F);
+    const u64_t group_mask = _capacity / group_width - 1;
+    u64_t group_ind = (hash >> 7) & group_mask;
+
+    // triangular probing visits every group when group count is a power of 2
+    for (u64_t step = 1; ; ++step) {
+        const group grp{ _ctrl + group_ind * group_width };
+        for (u32_t match = grp.match(h2); match != 0; match &= match - 1) {
+            const u64_t index = group_ind * group_width + std::countr_zero(match);
+            if (key_of(_slots[index]) == key) {
+                return index;
+            }
+        }
+        if (grp.match_empty() != 0) {
+            return index_null;
+        }
+        group_ind = (group_ind + step) & group_mask;
+    }
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+u64_t flat_hash_table<Value, Key, KeyOf, Hash>::prepare_insert(u64_t hash) {
+    using namespace hashmap_detail;
+
+    if (_growth_left == 0) {
+        // mostly tombstones, clean up in place, otherwise grow
+        rehash(_size * 2 < max_load(_capacity) ? _capacity : (std::max)(_capacity * 2, group_width));
+    }
+
+    const u64_t index = find_free(hash);
+    if (_ctrl[index] == ctrl_empty) {
+        _growth_left -= 1;
+    }
+    _ctrl[index] = static_cast<ctrl_t>(hash & 0x7F);
+    _size += 1;
+
+    return index;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+u64_t flat_hash_table<Value, Key, KeyOf, Hash>::find_free(u64_t hash) const noexcept {
+    using namespace hashmap_detail;
+
+    const u64_t group_mask = _capacity / group_width - 1;
+    u64_t group_ind = (hash >> 7) & group_mask;
+
+    for (u64_t step = 1; ; ++step) {
+        const u32_t free = group{ _ctrl + group_ind * group_width }.match_free();
+        if (free != 0) {
+            return group_ind * group_width + std::countr_zero(free);
+        }
+        group_ind = (group_ind + step) & group_mask;
+    }
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::rehash(u64_t capacity) {
+    hashmap_detail::ctrl_t* old_ctrl = _ctrl;
+    Value* old_slots = _slots;
+    const u64_t old_capacity = _capacity;
+
+    allocate(capacity);
+    _growth_left = max_load(capacity) - _size;
+
+    for (u64_t i = 0; i < old_capacity; ++i) {
+        if (old_ctrl[i] < 0) {
+            continue;
+        }
+        const u64_t hash = hash_of(key_of(old_slots[i]));
+        const u64_t index = find_free(hash);
+        _ctrl[index] = static_cast<hashmap_detail::ctrl_t>(hash & 0x7F);
+
+        std::construct_at(&_slots[index], std::move(old_slots[i]));
+        std::destroy_at(&old_slots[i]);
+    }
+
+    if (old_ctrl != nullptr) {
+        _resource->deallocate(old_ctrl, slot_offset(old_capacity) + sizeof(Value) * old_capacity, alloc_alignment);
+    }
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::allocate(u64_t capacity) {
+    // control bytes first, slots after them in the same block
+    auto* block = static_cast<std::byte*>(_resource->allocate(slot_offset(capacity) + sizeof(Value) * capacity, alloc_alignment));
+    _ctrl = reinterpret_cast<hashmap_detail::ctrl_t*>(block);
+    _slots = reinterpret_cast<Value*>(block + slot_offset(capacity));
+    _capacity = capacity;
+
+    std::memset(_ctrl, hashmap_detail::ctrl_empty, capacity);
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::deallocate() {
+    if (_ctrl != nullptr) {
+        _resource->deallocate(_ctrl, slot_offset(_capacity) + sizeof(Value) * _capacity, alloc_alignment);
+    }
+    _ctrl = nullptr;
+    _slots = nullptr;
+    _capacity = 0;
+    _size = 0;
+    _growth_left = 0;
+}
+
+template<typename Value, typename Key, auto KeyOf, typename Hash>
+void flat_hash_table<Value, Key, KeyOf, Hash>::destroy_slots() {
+    if constexpr (!std::is_trivially_destructible_v<Value>) {
+        for (u64_t i = 0; i < _capacity; ++i) {
+            if (_ctrl[i] >= 0) {
+                std::destroy_at(&_slots[i]);
+            }
+        }
+    }
+}
 
 }
 
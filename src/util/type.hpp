@@ -4,6 +4,7 @@
 #define DRY_UTIL_TYPE_H
 
 #include <cstdint>
+#include <type_traits>
 
 namespace dry::util {
 
@@ -25,6 +26,15 @@ struct type_id {
     }
 };
 
+// position of T in Ts, the compile time counterpart of type_id for a closed set of types
+template<typename T, typename... Ts>
+consteval id_type type_index() {
+    static_assert((std::is_same_v<T, Ts> || ...), "T is not part of Ts");
+    id_type ret = 0;
+    static_cast<void>(((std::is_same_v<T, Ts> ? true : (++ret, false)) || ...));
+    return ret;
+}
+
 }
 
 #endif
@@ -12,6 +12,10 @@ void copy_buffer(const vk_cmd_buffer& cmd, VkBuffer src, VkBuffer dst, VkDeviceS
     vkCmdCopyBuffer(cmd.handle(), src, dst, 1, &copy_region);
 }
 
+void copy_buffer_regions(const vk_cmd_buffer& cmd, VkBuffer src, VkBuffer dst, std::span<const VkBufferCopy> regions) {
+    vkCmdCopyBuffer(cmd.handle(), src, dst, static_cast<u32_t>(regions.size()), regions.data());
+}
+
 void copy_buffer_to_image(const vk_cmd_buffer& cmd, VkBuffer buffer, const vk_image& image) {
     VkBufferImageCopy region{};
     region.bufferOffset = 0;
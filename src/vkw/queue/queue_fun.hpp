@@ -16,6 +16,7 @@ auto execute_cmd_once(const vk_queue& queue, Args&&... args);
 template<typename T>
 vk_buffer create_local_buffer(const vk_queue& queue, const vk_device& device, std::span<const T> values, VkBufferUsageFlags usage);
 void copy_buffer(const vk_cmd_buffer& cmd, VkBuffer src, VkBuffer dst, VkDeviceSize size);
+void copy_buffer_regions(const vk_cmd_buffer& cmd, VkBuffer src, VkBuffer dst, std::span<const VkBufferCopy> regions);
 void copy_buffer_to_image(const vk_cmd_buffer& cmd, VkBuffer buffer, const vk_image& image);
 // graphics
 void transition_image_layout(const vk_cmd_buffer& cmd, const vk_image& image, VkImageLayout layout_old, VkImageLayout layout_new);